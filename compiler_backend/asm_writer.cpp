@@ -0,0 +1,42 @@
+#include "asm_writer.h"
+#include "hack_code.h"
+
+#include <cstdlib>
+#include <iostream>
+
+/* -------------------------------------------------------------------------- */
+
+AsmWriter::AsmWriter(const std::string& outName) : outFile(outName) {
+    if (!outFile.is_open()) {
+        std::cerr << "ERROR: Could not open output file " << outName << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void AsmWriter::Address(const int value) { outFile << '@' << value << '\n'; }
+
+/* -------------------------------------------------------------------------- */
+
+void AsmWriter::Address(const std::string& symbol) {
+    outFile << '@' << symbol << '\n';
+}
+
+/* -------------------------------------------------------------------------- */
+
+void AsmWriter::Compute(const uint16_t code) {
+    outFile << DecodeCompute(code) << '\n';
+}
+
+/* -------------------------------------------------------------------------- */
+
+void AsmWriter::Label(const std::string& symbol) {
+    outFile << '(' << symbol << ")\n";
+}
+
+/* -------------------------------------------------------------------------- */
+
+void AsmWriter::Finish() { outFile.close(); }
+
+/* -------------------------------------------------------------------------- */
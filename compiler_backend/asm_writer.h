@@ -0,0 +1,30 @@
+#ifndef ASM_WRITER_H
+#define ASM_WRITER_H
+
+#include "instruction_sink.h"
+
+#include <fstream>
+#include <string>
+
+// writes Hack assembly text (.asm)
+class AsmWriter : public InstructionSink {
+  public:
+    AsmWriter(const std::string& outName);
+
+    // delete unwanted constructors
+    AsmWriter(const AsmWriter& that) = delete;
+    AsmWriter(const AsmWriter&& that) = delete;
+    AsmWriter& operator=(const AsmWriter& that) = delete;
+    AsmWriter& operator=(const AsmWriter&& that) = delete;
+
+    void Address(const int value) override;
+    void Address(const std::string& symbol) override;
+    void Compute(const uint16_t code) override;
+    void Label(const std::string& symbol) override;
+    void Finish() override;
+
+  private:
+    std::ofstream outFile;
+};
+
+#endif /* ASM_WRITER_H */
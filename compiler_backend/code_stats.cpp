@@ -0,0 +1,192 @@
+#include "code_stats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+/* -------------------------------------------------------------------------- */
+
+CodeStats::CodeStats() :
+        romWords(0),
+        blockOpen(false),
+        functions(),
+        functionIndex(),
+        opcodes(),
+        currFunction(0),
+        currOpcode() {}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeStats::SetContext(const std::string& function,
+                           const std::string& opcode) {
+    auto entry = functionIndex.find(function);
+    if (entry == functionIndex.end()) {
+        entry = functionIndex.insert({function, functions.size()}).first;
+        functions.emplace_back(function);
+        blockOpen = false;
+    }
+
+    if (entry->second != currFunction) blockOpen = false;
+
+    currFunction = entry->second;
+    currOpcode = opcode;
+    ++opcodes[opcode].commands;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeStats::AddInstruction(const bool isJump) {
+    if (functions.empty()) SetContext("global", "");
+
+    auto& function = functions[currFunction];
+
+    if (!blockOpen) {
+        function.blocks.emplace_back(romWords, "");
+        blockOpen = true;
+    }
+
+    ++function.blocks.back().cycles;
+    ++function.words;
+    if (IsOverhead(currOpcode)) ++function.overheadWords;
+    ++opcodes[currOpcode].words;
+    ++romWords;
+
+    // a jump ends the block, the next instruction starts a new one
+    if (isJump) blockOpen = false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeStats::AddLabel(const std::string& label) {
+    if (functions.empty()) SetContext("global", "");
+
+    auto& blocks = functions[currFunction].blocks;
+
+    // several labels at one address share a block
+    if (blockOpen && blocks.back().start == romWords) {
+        if (blocks.back().label.empty()) blocks.back().label = label;
+        return;
+    }
+
+    blocks.emplace_back(romWords, label);
+    blockOpen = true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeStats::PrintReport(std::ostream& out) const {
+    out << "ROM words: " << romWords << "\n\n";
+
+    out << std::left << std::setw(40) << "Function" << std::right
+        << std::setw(8) << "words" << std::setw(10) << "overhead"
+        << std::setw(8) << "share" << '\n';
+    for (const auto& function : functions) {
+        out << std::left << std::setw(40) << function.name << std::right
+            << std::setw(8) << function.words << std::setw(10)
+            << function.overheadWords << std::setw(7) << std::fixed
+            << std::setprecision(1) << Share(function.words, romWords)
+            << "%\n";
+    }
+
+    out << '\n'
+        << std::left << std::setw(40) << "VM opcode" << std::right
+        << std::setw(8) << "count" << std::setw(10) << "words"
+        << std::setw(8) << "share" << '\n';
+    for (const auto& opcode : OpcodesBySize()) {
+        out << std::left << std::setw(40) << opcode.first << std::right
+            << std::setw(8) << opcode.second.commands << std::setw(10)
+            << opcode.second.words << std::setw(7)
+            << Share(opcode.second.words, romWords) << "%\n";
+    }
+
+    const int overhead = OverheadWords();
+    out << "\nCall/return overhead (call, return, tail-call, function): "
+        << overhead << " words, " << Share(overhead, romWords) << "%\n";
+
+    out << "\nBasic blocks (address, label, static cycles)\n";
+    for (const auto& function : functions) {
+        out << function.name << '\n';
+        for (const auto& block : function.blocks) {
+            out << "  " << std::setw(6) << block.start << "  " << std::left
+                << std::setw(40) << (block.label.empty() ? "-" : block.label)
+                << std::right << std::setw(6) << block.cycles << '\n';
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeStats::PrintJSON(std::ostream& out) const {
+    // names are VM identifiers, which never need escaping
+    out << "{\n  \"romWords\": " << romWords << ",\n";
+    out << "  \"overheadWords\": " << OverheadWords() << ",\n";
+
+    out << "  \"functions\": [";
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const auto& function = functions[i];
+
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << function.name
+            << "\", \"words\": " << function.words
+            << ", \"overheadWords\": " << function.overheadWords
+            << ", \"blocks\": [";
+
+        for (size_t j = 0; j < function.blocks.size(); ++j) {
+            const auto& block = function.blocks[j];
+            out << (j == 0 ? "" : ", ") << "{\"start\": " << block.start
+                << ", \"label\": \"" << block.label
+                << "\", \"cycles\": " << block.cycles << '}';
+        }
+
+        out << "]}";
+    }
+    out << "\n  ],\n";
+
+    out << "  \"opcodes\": [";
+    bool first = true;
+    for (const auto& opcode : OpcodesBySize()) {
+        out << (first ? "\n" : ",\n") << "    {\"opcode\": \"" << opcode.first
+            << "\", \"count\": " << opcode.second.commands
+            << ", \"words\": " << opcode.second.words << '}';
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool CodeStats::IsOverhead(const std::string& opcode) const {
+    return std::find(overheadOpcodes.begin(), overheadOpcodes.end(), opcode) !=
+           overheadOpcodes.end();
+}
+
+/* -------------------------------------------------------------------------- */
+
+int CodeStats::OverheadWords() const {
+    int total = 0;
+    for (const auto& function : functions) {
+        total += function.overheadWords;
+    }
+
+    return total;
+}
+
+/* -------------------------------------------------------------------------- */
+
+std::vector<std::pair<std::string, CodeStats::Usage>> CodeStats::OpcodesBySize()
+    const {
+    std::vector<std::pair<std::string, Usage>> sorted(opcodes.begin(),
+                                                      opcodes.end());
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.second.words > b.second.words;
+                     });
+
+    return sorted;
+}
+
+/* -------------------------------------------------------------------------- */
+
+double CodeStats::Share(const int part, const int whole) {
+    return (whole == 0) ? 0.0 : 100.0 * part / whole;
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,78 @@
+#ifndef CODE_STATS_H
+#define CODE_STATS_H
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Size and cost report for translated code. CodeWriter tags the code it
+// emits with the VM function and opcode it belongs to; every Hack
+// instruction is one ROM word and takes one cycle, so a basic block's
+// static cycle estimate is its length (loops and callees not included).
+class CodeStats {
+  public:
+    CodeStats();
+
+    // remove unwanted constructors
+    CodeStats(const CodeStats& that) = delete;
+    CodeStats(const CodeStats&& that) = delete;
+    CodeStats& operator=(const CodeStats& that) = delete;
+    CodeStats& operator=(const CodeStats&& that) = delete;
+
+    void SetContext(const std::string& function, const std::string& opcode);
+    void AddInstruction(const bool isJump);
+    void AddLabel(const std::string& label);
+
+    void PrintReport(std::ostream& out) const;
+    void PrintJSON(std::ostream& out) const;
+
+  private:
+    struct Usage {
+        int commands;
+        int words;
+
+        Usage() : commands(0), words(0) {}
+    };
+
+    struct Block {
+        int start;
+        std::string label;
+        int cycles;
+
+        Block(const int s, const std::string& l) : start(s), label(l), cycles(0) {}
+    };
+
+    struct FunctionStats {
+        std::string name;
+        int words;
+        int overheadWords;
+        std::vector<Block> blocks;
+
+        FunctionStats(const std::string& n) :
+                name(n),
+                words(0),
+                overheadWords(0),
+                blocks() {}
+    };
+
+    int romWords;
+    bool blockOpen;
+    std::vector<FunctionStats> functions;
+    std::map<std::string, size_t> functionIndex;
+    std::map<std::string, Usage> opcodes;
+    size_t currFunction;
+    std::string currOpcode;
+
+    // opcodes counted as call/return overhead
+    const std::vector<std::string> overheadOpcodes = {"call", "return",
+                                                      "tail-call", "function"};
+
+    // methods
+    bool IsOverhead(const std::string& opcode) const;
+    int OverheadWords() const;
+    std::vector<std::pair<std::string, Usage>> OpcodesBySize() const;
+    static double Share(const int part, const int whole);
+};
+
+#endif /* CODE_STATS_H */
@@ -1,38 +1,193 @@
 #include "code_writer.h"
+#include "asm_writer.h"
+#include "hack_assembler.h"
+#include "hack_code.h"
 
 #include <cstdlib>
 #include <iostream>
 
 /* -------------------------------------------------------------------------- */
 
-CodeWriter::CodeWriter(const std::string& outName) :
+CodeWriter::CodeWriter(const std::string& outName, const OutputFormat format) :
+        CodeWriter(MakeSink(outName, format)) {}
+
+/* -------------------------------------------------------------------------- */
+
+CodeWriter::CodeWriter(std::unique_ptr<InstructionSink> sink) :
         jumpIndex(0),
         returnIndex(0),
-        outFile(outName),
+        out(std::move(sink)),
+        stats(nullptr),
         infileName("XXX"),
-        currFunction("global") {
-    if (!outFile.is_open()) {
-        std::cerr << "ERROR: Could not open output file " << outName << '\n';
+        currFunction("global"),
+        pendingPreserved(0),
+        preserved(0),
+        deferred(Deferred::NONE),
+        deferredName(),
+        deferredArg(0),
+        deferredConstOperand(false),
+        deferredNegated(false),
+        inlineMath(true),
+        usesTailCall(false),
+        usesMultiply(false),
+        usesDivide(false) {}
+
+/* -------------------------------------------------------------------------- */
+
+std::unique_ptr<InstructionSink> CodeWriter::MakeSink(
+    const std::string& outName, const OutputFormat format) {
+    if (format == OutputFormat::HACK) {
+        return std::make_unique<HackAssembler>(outName);
+    }
+
+    return std::make_unique<AsmWriter>(outName);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeWriter::EmitAddress(const int value) {
+    if (stats) stats->AddInstruction(false);
+    out->Address(value);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeWriter::EmitAddress(const std::string& symbol) {
+    if (stats) stats->AddInstruction(false);
+    out->Address(symbol);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeWriter::EmitCompute(const std::string_view instr) {
+    const uint16_t code = EncodeCompute(instr);
+
+    if (code == 0) {
+        std::cerr << "ERROR: Invalid Hack instruction \"" << instr << "\"\n";
         std::exit(EXIT_FAILURE);
     }
+
+    // low three bits are the jump condition
+    if (stats) stats->AddInstruction((code & 0b111) != 0);
+    out->Compute(code);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeWriter::EmitLabel(const std::string& symbol) {
+    if (stats) stats->AddLabel(symbol);
+    out->Label(symbol);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// attribute the code emitted from here on to a VM opcode (for --stats)
+void CodeWriter::Tag(const std::string& opcode) { Tag(opcode, currFunction); }
+
+/* -------------------------------------------------------------------------- */
+
+void CodeWriter::Tag(const std::string& opcode, const std::string& function) {
+    if (stats) stats->SetContext(function, opcode);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeWriter::SetFileName(const std::string& fname) {
+    FlushDeferred();
+    infileName = fname;
 }
 
 /* -------------------------------------------------------------------------- */
 
 void CodeWriter::WriteInit() {
+    Tag("init", "(bootstrap)");
+
     // write stack start
-    outFile << "@256\n";
-    outFile << "D=A\n";
-    outFile << "@SP\n";
-    outFile << "M=D\n";
+    EmitAddress(256);
+    EmitCompute("D=A");
+    EmitAddress("SP");
+    EmitCompute("M=D");
 
     // call Sys.init
-    WriteCall("Sys.init", 0);
+    EmitCall("Sys.init", 0);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// NOTE: shared routines are placed after all translated code and are only
+//       reachable by explicit jumps
+void CodeWriter::Close() {
+    FlushDeferred();
+
+    if (usesTailCall) {
+        Tag("TAILCALL", "(runtime)");
+        WriteTailCallHelper();
+    }
+
+    if (usesMultiply) {
+        Tag("MULTIPLY", "(runtime)");
+        WriteMultiplyHelper();
+    }
+
+    if (usesDivide) {
+        Tag("DIVIDE", "(runtime)");
+        WriteDivideHelper();
+    }
+
+    out->Finish();
+}
+
+/* -------------------------------------------------------------------------- */
+
+// emit any command held back for fusion in its plain form
+void CodeWriter::FlushDeferred() {
+    const Deferred pending = deferred;
+    deferred = Deferred::NONE;
+
+    if (pending == Deferred::CALL) {
+        Tag("call");
+        EmitCall(deferredName, deferredArg);
+
+    } else if (pending == Deferred::PUSH_CONSTANT) {
+        Tag("push");
+        WritePush(constSegment, deferredArg);
+
+    } else if (pending == Deferred::COMPARISON) {
+        if (deferredConstOperand) {
+            Tag("push");
+            WritePush(constSegment, deferredArg);
+        }
+
+        Tag(deferredName);
+        WriteBinaryOp(deferredName);
+        if (deferredNegated) WriteUnaryOp("not");
+    }
 }
 
 /* -------------------------------------------------------------------------- */
 
+// comparisons are held back so that a following (not and) if-goto can jump
+// on the comparison directly instead of materializing a -1/0 value
 void CodeWriter::WriteArithmetic(const std::string& command) {
+    if (jumpConditions.find(command) != jumpConditions.end()) {
+        const bool constOperand = (deferred == Deferred::PUSH_CONSTANT);
+        if (!constOperand) FlushDeferred();
+
+        deferred = Deferred::COMPARISON;
+        deferredName = command;
+        deferredConstOperand = constOperand;
+        deferredNegated = false;
+        return;
+    }
+
+    if (command == "not" && deferred == Deferred::COMPARISON) {
+        deferredNegated = !deferredNegated;
+        return;
+    }
+
+    FlushDeferred();
+    Tag(command);
+
     if (binaryCommands.find(command) != binaryCommands.end()) {
         WriteBinaryOp(command);
 
@@ -49,10 +204,19 @@ void CodeWriter::WriteArithmetic(const std::string& command) {
 
 void CodeWriter::WritePushPop(const Command ptype, const std::string& segment,
                               const int index) {
-    if (ptype == Command::PUSH) {
+    FlushDeferred();
+
+    if (ptype == Command::PUSH && segment == constSegment) {
+        // may turn out to be a multiplication factor
+        deferred = Deferred::PUSH_CONSTANT;
+        deferredArg = index;
+
+    } else if (ptype == Command::PUSH) {
+        Tag("push");
         WritePush(segment, index);
 
     } else if (ptype == Command::POP) {
+        Tag("pop");
         WritePop(segment, index);
 
     } else {
@@ -64,16 +228,32 @@ void CodeWriter::WritePushPop(const Command ptype, const std::string& segment,
 
 void CodeWriter::WritePush(const std::string& segment, const int index) {
     if (segment == constSegment) {
-        outFile << '@' << index << '\n';  // int literal
-        outFile << "D=A\n";               // transfer to register
-        PushRegister("D");
+        if (index == 0 || index == 1) {
+            PushRegister(std::to_string(index));  // ALU constant
+
+        } else {
+            EmitAddress(index);  // int literal
+            EmitCompute("D=A");  // transfer to register
+            PushRegister("D");
+        }
 
     } else if (regMap.find(segment) != regMap.end()) {
-        outFile << '@' << index << '\n';               // load index
-        outFile << "D=A\n";                            // D = index
-        outFile << '@' << regMap.at(segment) << '\n';  // load segment
-        outFile << "A=M+D\n";                          // load Seg[index]
-        outFile << "D=M\n";                            // D = Seg[index]
+        if (index == 0) {
+            EmitAddress(regMap.at(segment));  // load segment
+            EmitCompute("A=M");               // load Seg[0]
+
+        } else if (index == 1) {
+            EmitAddress(regMap.at(segment));  // load segment
+            EmitCompute("A=M+1");             // load Seg[1]
+
+        } else {
+            EmitAddress(index);               // load index
+            EmitCompute("D=A");               // D = index
+            EmitAddress(regMap.at(segment));  // load segment
+            EmitCompute("A=D+M");             // load Seg[index]
+        }
+
+        EmitCompute("D=M");  // D = Seg[index]
         PushRegister("D");
 
     } else if (segment == tempSegment) {
@@ -83,8 +263,8 @@ void CodeWriter::WritePush(const std::string& segment, const int index) {
         PushFixed(segment, index, pointerBase, pointerMaxOffset);
 
     } else if (segment == staticSegment) {
-        outFile << '@' << infileName << '.' << index << '\n';
-        outFile << "D=M\n";
+        EmitAddress(infileName + '.' + std::to_string(index));
+        EmitCompute("D=M");
         PushRegister("D");
 
     } else {
@@ -104,31 +284,40 @@ void CodeWriter::PushFixed(const std::string& segment, const int index,
 
     const int address = base + index;
 
-    outFile << '@' << address << '\n';
-    outFile << "D=M\n";
+    EmitAddress(address);
+    EmitCompute("D=M");
     PushRegister("D");
 }
 
 /* -------------------------------------------------------------------------- */
 
 void CodeWriter::WritePop(const std::string& segment, const int index) {
-    if (regMap.find(segment) != regMap.end()) {
+    if (regMap.find(segment) != regMap.end() && index <= maxStepOffset) {
+        PopRegister("D");  // put val in D reg
+
+        EmitAddress(regMap.at(segment));  // load segment
+        EmitCompute(index == 0 ? "A=M" : "A=M+1");
+
+        // step up to Seg[index] without touching D
+        for (int i = 1; i < index; ++i) {
+            EmitCompute("A=A+1");
+        }
+
+        EmitCompute("M=D");  // Seg[index] = val
+
+    } else if (regMap.find(segment) != regMap.end()) {
+        EmitAddress(index);               // load index
+        EmitCompute("D=A");               // D = index
+        EmitAddress(regMap.at(segment));  // load segment
+        EmitCompute("D=D+M");             // D = addr Seg[index]
+        EmitAddress("R13");               // load scratch mem
+        EmitCompute("M=D");               // R13 = address
+
         PopRegister("D");  // put val in D reg
 
-        outFile << "@R13\n";                           // load scratch mem
-        outFile << "M=D\n";                            // R13 = val
-        outFile << '@' << index << '\n';               // load index
-        outFile << "D=A\n";                            // D = index
-        outFile << '@' << regMap.at(segment) << '\n';  // load segment
-        outFile << "A=M+D\n";                          // load Seg[index]
-        outFile << "D=A\n";                            // D = addr Seg[index]
-        outFile << "@R14\n";                           // load scratch mem
-        outFile << "M=D\n";                            // R14 = address
-        outFile << "@R13\n";                           // load scratch mem
-        outFile << "D=M\n";                            // D = val
-        outFile << "@R14\n";                           // load scratch mem
-        outFile << "A=M\n";                            // load address
-        outFile << "M=D\n";                            // M[address] = val
+        EmitAddress("R13");  // load scratch mem
+        EmitCompute("A=M");  // load address
+        EmitCompute("M=D");  // M[address] = val
 
     } else if (segment == tempSegment) {
         PopFixed(segment, index, tempBase, tempMaxOffset);
@@ -139,8 +328,8 @@ void CodeWriter::WritePop(const std::string& segment, const int index) {
     } else if (segment == staticSegment) {
         PopRegister("D");
 
-        outFile << '@' << infileName << '.' << index << '\n';
-        outFile << "M=D\n";
+        EmitAddress(infileName + '.' + std::to_string(index));
+        EmitCompute("M=D");
 
     } else {
         std::cerr << "WARNING: unrecognized segment \"" << segment << "\"\n";
@@ -161,18 +350,21 @@ void CodeWriter::PopFixed(const std::string& segment, const int index,
 
     PopRegister("D");
 
-    outFile << '@' << address << '\n';
-    outFile << "M=D\n";
+    EmitAddress(address);
+    EmitCompute("M=D");
 }
 
 /* -------------------------------------------------------------------------- */
 
 void CodeWriter::WriteLabel(const std::string& label, const bool isFunction) {
+    FlushDeferred();
+    Tag("label");
+
     if (isFunction) {
-        outFile << '(' << label << ")\n";
+        EmitLabel(label);
 
     } else {
-        outFile << '(' << currFunction << '$' << label << ")\n";
+        EmitLabel(currFunction + '$' + label);
 
     }
 }
@@ -181,185 +373,761 @@ void CodeWriter::WriteLabel(const std::string& label, const bool isFunction) {
 
 // unconditional jump
 void CodeWriter::WriteGoto(const std::string& label, const bool isFunction) {
+    FlushDeferred();
+    Tag("goto");
+
     if (isFunction) {
-        outFile << '@' << label << '\n';
+        EmitAddress(label);
 
     } else {
-        outFile << '@' << currFunction << '$' << label << '\n';
+        EmitAddress(currFunction + '$' + label);
 
     }
 
-    outFile << "0;JMP\n";
+    EmitCompute("0;JMP");
 }
 
 /* -------------------------------------------------------------------------- */
 
 // conditional jump (jump if stack entry != 0)
 void CodeWriter::WriteIf(const std::string& label) {
+    if (deferred == Deferred::COMPARISON) {
+        deferred = Deferred::NONE;
+        Tag(deferredName + "+if-goto");
+        EmitComparisonJump(label);
+        return;
+    }
+
+    FlushDeferred();
+    Tag("if-goto");
+
     PopRegister("D");
 
-    outFile << '@' << currFunction << '$' << label << '\n';
-    outFile << "D;JNE\n";
+    EmitAddress(currFunction + '$' + label);
+    EmitCompute("D;JNE");
+}
+
+/* -------------------------------------------------------------------------- */
+
+// fused comparison and if-goto: D = x - y, then a single conditional jump
+void CodeWriter::EmitComparisonJump(const std::string& label) {
+    if (deferredConstOperand) {
+        // y is a constant, x is on top of the stack
+        PopRegister("D");
+
+        if (deferredArg != 0) {
+            EmitAddress(deferredArg);
+            EmitCompute("D=D-A");
+        }
+
+    } else {
+        // pop y to D, then D = x - y while popping x
+        PopRegister("D");
+        EmitAddress("SP");
+        EmitCompute("AM=M-1");
+        EmitCompute("D=M-D");
+    }
+
+    const auto& conditions =
+        deferredNegated ? negatedJumpConditions : jumpConditions;
+
+    EmitAddress(currFunction + '$' + label);
+    EmitCompute("D;" + conditions.at(deferredName));
 }
 
 /* -------------------------------------------------------------------------- */
 
+// calls are held back until the next command, so that a call immediately
+// followed by return can reuse the current frame (see EmitTailCall)
 void CodeWriter::WriteCall(const std::string& functionName, int nArgs) {
+    if (inlineMath && nArgs == 2 && functionName == multiplyFunction) {
+        if (deferred == Deferred::PUSH_CONSTANT) {
+            deferred = Deferred::NONE;
+            Tag("multiply");
+            EmitConstantMultiply(deferredArg);
+            return;
+        }
+
+        FlushDeferred();
+        Tag("multiply");
+        usesMultiply = true;
+        EmitRoutineCall("MULTIPLY");
+        return;
+    }
+
+    if (inlineMath && nArgs == 2 && functionName == divideFunction) {
+        if (deferred == Deferred::PUSH_CONSTANT && deferredArg == 1) {
+            // x / 1 leaves x on the stack
+            deferred = Deferred::NONE;
+            return;
+        }
+
+        FlushDeferred();
+        Tag("divide");
+        usesDivide = true;
+        EmitRoutineCall("DIVIDE");
+        return;
+    }
+
+    FlushDeferred();
+
+    deferred = Deferred::CALL;
+    deferredName = functionName;
+    deferredArg = nArgs;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeWriter::EmitCall(const std::string& functionName, int nArgs) {
     const std::string retLabel = "Ret." + functionName + std::to_string(returnIndex);
 
     ++returnIndex;
 
     // push return-address
-    outFile << '@' << retLabel << '\n';
+    EmitAddress(retLabel);
     PushRegister("A");
 
+    PushCallFrame(nArgs);
+
+    // goto f
+    EmitAddress(functionName);
+    EmitCompute("0;JMP");
+
+    // label return-address
+    EmitLabel(retLabel);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// saves the caller's segment pointers once the return address is pushed
+void CodeWriter::PushCallFrame(int nArgs) {
     // push LCL
-    outFile << "@LCL\n";
-    outFile << "D=M\n";
+    EmitAddress("LCL");
+    EmitCompute("D=M");
     PushRegister("D");
 
     // push ARG
-    outFile << "@ARG\n";
-    outFile << "D=M\n";
+    EmitAddress("ARG");
+    EmitCompute("D=M");
     PushRegister("D");
 
     // push THIS
-    outFile << "@THIS\n";
-    outFile << "D=M\n";
+    EmitAddress("THIS");
+    EmitCompute("D=M");
     PushRegister("D");
 
     // push THAT
-    outFile << "@THAT\n";
-    outFile << "D=M\n";
+    EmitAddress("THAT");
+    EmitCompute("D=M");
     PushRegister("D");
 
     // ARG = SP-n-5
     int backShift = nArgs + savedStackSize;
-    outFile << '@' << backShift << '\n';
-    outFile << "D=A\n";
-    outFile << "@SP\n";
-    outFile << "D=M-D\n";
-    outFile << "@ARG\n";
-    outFile << "M=D\n";
+    EmitAddress(backShift);
+    EmitCompute("D=A");
+    EmitAddress("SP");
+    EmitCompute("D=M-D");
+    EmitAddress("ARG");
+    EmitCompute("M=D");
 
     // LCL = SP
-    outFile << "@SP\n";
-    outFile << "D=M\n";
-    outFile << "@LCL\n";
-    outFile << "M=D\n";
+    EmitAddress("SP");
+    EmitCompute("D=M");
+    EmitAddress("LCL");
+    EmitCompute("M=D");
+}
+
+/* -------------------------------------------------------------------------- */
+
+// NOTE: the new arguments replace the current ones and the callee returns
+//       straight to our caller, so the stack does not grow. When the caller
+//       received as many arguments as it passes on, the saved frame is
+//       already in place and only the arguments are copied; otherwise the
+//       shared TAILCALL routine rebuilds the frame.
+void CodeWriter::EmitTailCall(const std::string& functionName, int nArgs) {
+    const std::string fastLabel = "TAILFAST" + std::to_string(jumpIndex);
+    ++jumpIndex;
+    usesTailCall = true;
+
+    // the callee's return may leave THIS and THAT as they are, so put back
+    // the caller's values unless this function kept them too
+    if (!(preserved & vmb::PRESERVE_THAT)) {
+        RestoreFrameRegister("THAT", 1);
+    }
+
+    if (!(preserved & vmb::PRESERVE_THIS)) {
+        RestoreFrameRegister("THIS", 2);
+    }
+
+    // frame is in place if LCL == ARG + n + 5
+    EmitAddress("ARG");
+    EmitCompute("D=M");
+    EmitAddress(nArgs + savedStackSize);
+    EmitCompute("D=D+A");
+    EmitAddress("LCL");
+    EmitCompute("D=M-D");
+    EmitAddress(fastLabel);
+    EmitCompute("D;JEQ");
+
+    // general case: R13 = n, R14 = f, goto TAILCALL
+    EmitAddress(nArgs);
+    EmitCompute("D=A");
+    EmitAddress("R13");
+    EmitCompute("M=D");
+    EmitAddress(functionName);
+    EmitCompute("D=A");
+    EmitAddress("R14");
+    EmitCompute("M=D");
+    EmitAddress("TAILCALL");
+    EmitCompute("0;JMP");
+
+    // fast case: pop arguments into ARG[n-1] ... ARG[0]
+    EmitLabel(fastLabel);
+    EmitAddress("ARG");
+    EmitCompute("D=M");
+    EmitAddress(nArgs);
+    EmitCompute("D=D+A");
+    EmitAddress("R13");
+    EmitCompute("M=D");
+
+    for (int i = 0; i < nArgs; ++i) {
+        EmitAddress("SP");
+        EmitCompute("AM=M-1");
+        EmitCompute("D=M");
+        EmitAddress("R13");
+        EmitCompute("AM=M-1");
+        EmitCompute("M=D");
+    }
+
+    // SP = LCL, saved frame and LCL stay as they are
+    EmitAddress("LCL");
+    EmitCompute("D=M");
+    EmitAddress("SP");
+    EmitCompute("M=D");
 
     // goto f
-    WriteGoto(functionName, true);
+    EmitAddress(functionName);
+    EmitCompute("0;JMP");
+}
 
-    // label return-address
-    WriteLabel(retLabel, true);
+/* -------------------------------------------------------------------------- */
+
+// tail call with a differently sized frame: R13 = nArgs, R14 = target
+void CodeWriter::WriteTailCallHelper() {
+    EmitLabel("TAILCALL");
+
+    // R15 = FRAME - 5
+    EmitAddress(savedStackSize);
+    EmitCompute("D=A");
+    EmitAddress("LCL");
+    EmitCompute("D=M-D");
+    EmitAddress("R15");
+    EmitCompute("M=D");
+
+    // push saved RET, LCL, ARG, THIS, THAT above the new arguments
+    for (int i = 0; i < savedStackSize; ++i) {
+        EmitAddress("R15");
+        EmitCompute("M=M+1");
+        EmitCompute("A=M-1");
+        EmitCompute("D=M");
+        PushRegister("D");
+    }
+
+    // R13 = n + 5 words to move, R15 = SP - (n + 5) is the source
+    EmitAddress(savedStackSize);
+    EmitCompute("D=A");
+    EmitAddress("R13");
+    EmitCompute("MD=D+M");
+    EmitAddress("SP");
+    EmitCompute("D=M-D");
+    EmitAddress("R15");
+    EmitCompute("M=D");
+
+    // LCL walks from ARG as the destination, ending at the new LCL
+    EmitAddress("ARG");
+    EmitCompute("D=M");
+    EmitAddress("LCL");
+    EmitCompute("M=D");
+
+    // the destination never passes the source, so copy upwards
+    EmitLabel("TAILCALL_LOOP");
+    EmitAddress("R15");
+    EmitCompute("M=M+1");
+    EmitCompute("A=M-1");
+    EmitCompute("D=M");
+    EmitAddress("LCL");
+    EmitCompute("M=M+1");
+    EmitCompute("A=M-1");
+    EmitCompute("M=D");
+    EmitAddress("R13");
+    EmitCompute("MD=M-1");
+    EmitAddress("TAILCALL_LOOP");
+    EmitCompute("D;JGT");
+
+    // SP = LCL, goto target
+    EmitAddress("LCL");
+    EmitCompute("D=M");
+    EmitAddress("SP");
+    EmitCompute("M=D");
+    EmitAddress("R14");
+    EmitCompute("A=M");
+    EmitCompute("0;JMP");
+}
+
+/* -------------------------------------------------------------------------- */
+
+// shared routines take their operands from the stack, leave the result in
+// place of the operands and return through R15
+void CodeWriter::EmitRoutineCall(const std::string& routine) {
+    const std::string retLabel = "Ret." + routine + std::to_string(returnIndex);
+    ++returnIndex;
+
+    EmitAddress(retLabel);
+    EmitCompute("D=A");
+    EmitAddress("R15");
+    EmitCompute("M=D");
+    EmitAddress(routine);
+    EmitCompute("0;JMP");
+    EmitLabel(retLabel);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// x * factor for x on top of the stack, using a double-and-add chain over the
+// bits of the factor (so powers of two only double)
+void CodeWriter::EmitConstantMultiply(const int factor) {
+    if (factor == 0) {
+        EmitAddress("SP");
+        EmitCompute("A=M-1");
+        EmitCompute("M=0");
+        return;
+    }
+
+    if (factor == 1) return;
+
+    int topBit = 15;
+    int bitCount = 0;
+    for (int bit = 0; bit < 16; ++bit) {
+        if ((factor >> bit) & 1) {
+            topBit = bit;
+            ++bitCount;
+        }
+    }
+
+    if (bitCount > maxInlineMultiplyBits) {
+        WritePush(constSegment, factor);
+        usesMultiply = true;
+        EmitRoutineCall("MULTIPLY");
+        return;
+    }
+
+    // R13 = x, D = running product
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("D=M");
+    EmitAddress("R13");
+    EmitCompute("M=D");
+
+    for (int bit = topBit - 1; bit >= 0; --bit) {
+        // D = D + D
+        EmitAddress("R14");
+        EmitCompute("M=D");
+        EmitCompute("D=D+M");
+
+        if ((factor >> bit) & 1) {
+            EmitAddress("R13");
+            EmitCompute("D=D+M");
+        }
+    }
+
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("M=D");
+}
+
+/* -------------------------------------------------------------------------- */
+
+// stack: x y -> x * y
+// R13 = product, R14 = x shifted left, y is cleared bit by bit so the loop
+// ends as soon as no set bits remain. The bit mask lives just above the stack.
+void CodeWriter::WriteMultiplyHelper() {
+    EmitLabel("MULTIPLY");
+
+    EmitAddress("R13");
+    EmitCompute("M=0");
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("A=A-1");
+    EmitCompute("D=M");
+    EmitAddress("R14");
+    EmitCompute("M=D");
+    EmitAddress("SP");
+    EmitCompute("A=M");
+    EmitCompute("M=1");
+    EmitCompute("A=A-1");
+    EmitCompute("D=M");
+    EmitAddress("MULTIPLY_END");
+    EmitCompute("D;JEQ");
+
+    EmitLabel("MULTIPLY_LOOP");
+
+    // D = mask & y
+    EmitAddress("SP");
+    EmitCompute("A=M");
+    EmitCompute("D=M");
+    EmitCompute("A=A-1");
+    EmitCompute("D=D&M");
+    EmitAddress("MULTIPLY_SKIP");
+    EmitCompute("D;JEQ");
+
+    // clear the bit in y, product += x
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("M=M-D");
+    EmitAddress("R14");
+    EmitCompute("D=M");
+    EmitAddress("R13");
+    EmitCompute("M=D+M");
+
+    EmitLabel("MULTIPLY_SKIP");
+
+    // x += x, mask += mask
+    EmitAddress("R14");
+    EmitCompute("D=M");
+    EmitCompute("M=D+M");
+    EmitAddress("SP");
+    EmitCompute("A=M");
+    EmitCompute("D=M");
+    EmitCompute("M=D+M");
+
+    // repeat while y has bits left
+    EmitCompute("A=A-1");
+    EmitCompute("D=M");
+    EmitAddress("MULTIPLY_LOOP");
+    EmitCompute("D;JNE");
+
+    EmitLabel("MULTIPLY_END");
+    EmitAddress("R13");
+    EmitCompute("D=M");
+    EmitAddress("SP");
+    EmitCompute("AM=M-1");
+    EmitCompute("A=A-1");
+    EmitCompute("M=D");
+    EmitAddress("R15");
+    EmitCompute("A=M");
+    EmitCompute("0;JMP");
+}
+
+/* -------------------------------------------------------------------------- */
+
+// stack: x y -> x / y, truncated towards zero
+// Restoring division on the unsigned magnitudes: R13 = remainder, R14 = |x|
+// shifted left, the quotient builds up in the x slot and |y| replaces y.
+// The bit counter and the result sign live just above the stack. Division
+// by zero is handed to the OS routine so it can report the error.
+void CodeWriter::WriteDivideHelper() {
+    EmitLabel("DIVIDE");
+
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("D=M");
+    EmitAddress("DIVIDE_ZERO");
+    EmitCompute("D;JEQ");
+
+    // sign = 0, y = |y|
+    EmitAddress("SP");
+    EmitCompute("A=M+1");
+    EmitCompute("M=0");
+    EmitAddress("DIVIDE_YPOS");
+    EmitCompute("D;JGE");
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("M=-M");
+    EmitCompute("A=A+1");
+    EmitCompute("A=A+1");
+    EmitCompute("M=!M");
+    EmitLabel("DIVIDE_YPOS");
+
+    // R14 = |x|
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("A=A-1");
+    EmitCompute("D=M");
+    EmitAddress("DIVIDE_XPOS");
+    EmitCompute("D;JGE");
+    EmitAddress("SP");
+    EmitCompute("A=M+1");
+    EmitCompute("M=!M");
+    EmitCompute("D=-D");
+    EmitLabel("DIVIDE_XPOS");
+    EmitAddress("R14");
+    EmitCompute("M=D");
+
+    // quotient = 0, remainder = 0, counter = 16
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("A=A-1");
+    EmitCompute("M=0");
+    EmitAddress("R13");
+    EmitCompute("M=0");
+    EmitAddress(16);
+    EmitCompute("D=A");
+    EmitAddress("SP");
+    EmitCompute("A=M");
+    EmitCompute("M=D");
+
+    // leading zero bits of |x| leave everything at zero
+    EmitLabel("DIVIDE_SKIP");
+    EmitAddress("R14");
+    EmitCompute("D=M");
+    EmitAddress("DIVIDE_LOOP");
+    EmitCompute("D;JLT");
+    EmitAddress("DIVIDE_END");
+    EmitCompute("D;JEQ");
+    EmitAddress("R14");
+    EmitCompute("M=D+M");
+    EmitAddress("SP");
+    EmitCompute("A=M");
+    EmitCompute("M=M-1");
+    EmitAddress("DIVIDE_SKIP");
+    EmitCompute("0;JMP");
+
+    EmitLabel("DIVIDE_LOOP");
+
+    // remainder = 2 * remainder + top bit of |x|, |x| += |x|
+    EmitAddress("R13");
+    EmitCompute("D=M");
+    EmitCompute("M=D+M");
+    EmitAddress("R14");
+    EmitCompute("D=M");
+    EmitCompute("M=D+M");
+    EmitAddress("DIVIDE_BIT");
+    EmitCompute("D;JGE");
+    EmitAddress("R13");
+    EmitCompute("M=M+1");
+    EmitLabel("DIVIDE_BIT");
+
+    // quotient += quotient
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("A=A-1");
+    EmitCompute("D=M");
+    EmitCompute("M=D+M");
+
+    // unsigned remainder >= |y| (|y| <= 32768, remainder < 2 * |y|)
+    EmitAddress("R13");
+    EmitCompute("D=M");
+    EmitAddress("DIVIDE_SUB");
+    EmitCompute("D;JLT");
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("D=M");
+    EmitAddress("DIVIDE_NEXT");
+    EmitCompute("D;JLT");
+    EmitAddress("R13");
+    EmitCompute("D=M-D");
+    EmitAddress("DIVIDE_NEXT");
+    EmitCompute("D;JLT");
+
+    // remainder -= |y|, quotient += 1
+    EmitLabel("DIVIDE_SUB");
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("D=M");
+    EmitAddress("R13");
+    EmitCompute("M=M-D");
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("A=A-1");
+    EmitCompute("M=M+1");
+
+    EmitLabel("DIVIDE_NEXT");
+    EmitAddress("SP");
+    EmitCompute("A=M");
+    EmitCompute("MD=M-1");
+    EmitAddress("DIVIDE_LOOP");
+    EmitCompute("D;JGT");
+
+    // apply sign and drop y
+    EmitLabel("DIVIDE_END");
+    EmitAddress("SP");
+    EmitCompute("A=M+1");
+    EmitCompute("D=M");
+    EmitAddress("DIVIDE_DONE");
+    EmitCompute("D;JEQ");
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("A=A-1");
+    EmitCompute("M=-M");
+    EmitLabel("DIVIDE_DONE");
+    EmitAddress("SP");
+    EmitCompute("M=M-1");
+    EmitAddress("R15");
+    EmitCompute("A=M");
+    EmitCompute("0;JMP");
+
+    // regular call to the OS routine, returning to the original call site
+    EmitLabel("DIVIDE_ZERO");
+    EmitAddress("R15");
+    EmitCompute("D=M");
+    PushRegister("D");
+    PushCallFrame(2);
+    EmitAddress(divideFunction);
+    EmitCompute("0;JMP");
 }
 
 /* -------------------------------------------------------------------------- */
 
 void CodeWriter::WriteFunction(const std::string& functionName, int nLocals) {
-    WriteLabel(functionName, true);
+    FlushDeferred();
+
+    currFunction = functionName;
+    preserved = pendingPreserved;
+    pendingPreserved = 0;
+    Tag("function");
+
+    EmitLabel(functionName);
 
     for (int i = 0; i < nLocals; ++i) {
         WritePush(constSegment, 0);
     }
-
-    currFunction = functionName;
 }
 
 /* -------------------------------------------------------------------------- */
 
 void CodeWriter::WriteReturn() {
+    if (deferred == Deferred::CALL) {
+        deferred = Deferred::NONE;
+        Tag("tail-call");
+        EmitTailCall(deferredName, deferredArg);
+        return;
+    }
+
+    FlushDeferred();
+    Tag("return");
 
     // FRAME (R13) = LCL
-    outFile << "@LCL\n";
-    outFile << "D=M\n";
-    outFile << "@R13\n";
-    outFile << "M=D\n";
-
-    // RET (R14) = *(FRAME - 5)
-    outFile << '@' << savedStackSize << '\n';
-    outFile << "D=A\n";
-    outFile << "@R13\n";
-    outFile << "A=M\n";
-    outFile << "D=A-D\n";
-    outFile << "A=D\n";
-    outFile << "D=M\n";
-    outFile << "@R14\n";
-    outFile << "M=D\n";
+    EmitAddress("LCL");
+    EmitCompute("D=M");
+    EmitAddress("R13");
+    EmitCompute("M=D");
+
+    // RET (R14) = *(FRAME - 5), FRAME is still in D
+    EmitAddress(savedStackSize);
+    EmitCompute("A=D-A");
+    EmitCompute("D=M");
+    EmitAddress("R14");
+    EmitCompute("M=D");
 
     // *ARG = pop() -> put return value on stack
     PopRegister("D");
-    outFile << "@ARG\n";
-    outFile << "A=M\n";
-    outFile << "M=D\n";
+    EmitAddress("ARG");
+    EmitCompute("A=M");
+    EmitCompute("M=D");
 
     // SP = ARG + 1
-    outFile << "@ARG\n";
-    outFile << "D=M+1\n";
-    outFile << "@SP\n";
-    outFile << "M=D\n";
+    EmitAddress("ARG");
+    EmitCompute("D=M+1");
+    EmitAddress("SP");
+    EmitCompute("M=D");
+
+    // THAT = *(FRAME - 1), THIS = *(FRAME - 2), unless the function left
+    // them alone
+    int skipped = 0;
 
-    // THAT = *(FRAME - 1)
-    PopFrame("THAT");
+    if (preserved & vmb::PRESERVE_THAT) {
+        ++skipped;
+    } else {
+        PopFrame("THAT", skipped);
+    }
 
-    // THIS = *(FRAME - 2)
-    PopFrame("THIS");
+    if (preserved & vmb::PRESERVE_THIS) {
+        ++skipped;
+    } else {
+        PopFrame("THIS", skipped);
+        skipped = 0;
+    }
 
     // ARG = *(FRAME - 3)
-    PopFrame("ARG");
+    PopFrame("ARG", skipped);
 
     // LCL = *(FRAME - 4)
-    PopFrame("LCL");
+    PopFrame("LCL", 0);
 
     // goto RET (R14)
-    outFile << "@R14\n";
-    outFile << "A=M\n";
-    outFile << "0;JMP\n";
+    EmitAddress("R14");
+    EmitCompute("A=M");
+    EmitCompute("0;JMP");
+}
+
+/* -------------------------------------------------------------------------- */
+
+// steps FRAME (R13) past skipped unread slots and the next one, and loads
+// reg from there
+void CodeWriter::PopFrame(const std::string& reg, const int skipped) {
+    if (skipped > 1) {
+        EmitAddress(skipped + 1);
+        EmitCompute("D=A");
+        EmitAddress("R13");
+        EmitCompute("AM=M-D");
+
+    } else {
+        EmitAddress("R13");
+        if (skipped == 1) EmitCompute("M=M-1");
+        EmitCompute("AM=M-1");
+    }
+
+    EmitCompute("D=M");
+    EmitAddress(reg);
+    EmitCompute("M=D");
 }
 
 /* -------------------------------------------------------------------------- */
 
-void CodeWriter::PopFrame(const std::string& reg) {
-    outFile << "@R13\n";
-    outFile << "M=M-1\n";
-    outFile << "A=M\n";
-    outFile << "D=M\n";
-    outFile << '@' << reg << '\n';
-    outFile << "M=D\n";
+// reg = *(LCL - offset), the value saved by the caller
+void CodeWriter::RestoreFrameRegister(const std::string& reg,
+                                      const int offset) {
+    EmitAddress("LCL");
+    EmitCompute("A=M-1");
+
+    for (int i = 1; i < offset; ++i) {
+        EmitCompute("A=A-1");
+    }
+
+    EmitCompute("D=M");
+    EmitAddress(reg);
+    EmitCompute("M=D");
 }
 
 /* -------------------------------------------------------------------------- */
 
+// x is replaced in place by the result, so SP only moves once
 void CodeWriter::WriteBinaryOp(const std::string& command) {
-    // pop y to D, x to A
+    // pop y to D, point A at x
     PopRegister("D");
-    PopRegister("A");
+    EmitCompute("A=A-1");
 
     WriteOpCommand(command);
-
-    PushRegister("D");
 }
 
 /* -------------------------------------------------------------------------- */
 
 void CodeWriter::WriteUnaryOp(const std::string& command) {
-    // pop x to D
-    PopRegister("D");
+    // point A at x, SP is unchanged
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
 
     WriteOpCommand(command);
-
-    PushRegister("D");
 }
 
 /* -------------------------------------------------------------------------- */
 
 void CodeWriter::WriteOpCommand(const std::string& command) {
     if (command == "add")
-        outFile << "D=A+D\n";
+        EmitCompute("M=D+M");
 
     else if (command == "sub")
-        outFile << "D=A-D\n";
+        EmitCompute("M=M-D");
 
     else if (command == "eq")
         WriteComparison("JEQ");
@@ -371,16 +1139,16 @@ void CodeWriter::WriteOpCommand(const std::string& command) {
         WriteComparison("JLT");
 
     else if (command == "and")
-        outFile << "D=A&D\n";
+        EmitCompute("M=D&M");
 
     else if (command == "or")
-        outFile << "D=A|D\n";
+        EmitCompute("M=D|M");
 
     else if (command == "neg")
-        outFile << "D=-D\n";
+        EmitCompute("M=-M");
 
     else if (command == "not")
-        outFile << "D=!D\n";
+        EmitCompute("M=!M");
 
     else
         std::cerr << "WARNING: Unrecognized operator \"" << command << "\"\n";
@@ -388,47 +1156,47 @@ void CodeWriter::WriteOpCommand(const std::string& command) {
 
 /* -------------------------------------------------------------------------- */
 
+// NOTE: the constants 0, 1 and -1 are stored directly without going
+//       through D
 void CodeWriter::PushRegister(const std::string& reg) {
-    if (reg != "D") {
-        outFile << "D=" << reg << '\n';  // save register value
+    const bool direct = (reg == "D" || reg == "0" || reg == "1" || reg == "-1");
+
+    if (!direct) {
+        EmitCompute("D=" + reg);  // save register value
     }
 
-    outFile << "@SP\n";              // look up stack pointer
-    outFile << "A=M\n";              // A = pointer val
-    outFile << "M=D\n";              // M[val] = reg
-    outFile << "D=A\n";              // D = val
-    outFile << "@SP\n";              // look up stack pointer
-    outFile << "M=D+1\n";            // increment stack pointer
+    EmitAddress("SP");                         // look up stack pointer
+    EmitCompute("AM=M+1");                     // increment stack pointer
+    EmitCompute("A=A-1");                      // A = old pointer val
+    EmitCompute("M=" + (direct ? reg : "D"));  // M[val] = reg
 }
 
 /* -------------------------------------------------------------------------- */
 
 void CodeWriter::PopRegister(const std::string& reg) {
-    outFile << "@SP\n";        // look up stack pointer
-    outFile << "M=M-1\n";      // decrement SP
-    outFile << "@SP\n";        // reload SP
-    outFile << "A=M\n";        // A = pointer val
-    outFile << reg << "=M\n";  // target reg = M[val]
+    EmitAddress("SP");        // look up stack pointer
+    EmitCompute("AM=M-1");    // decrement SP, A = pointer val
+    EmitCompute(reg + "=M");  // target reg = M[val]
 }
 
 /* -------------------------------------------------------------------------- */
 
-// NOTE: truth value indicator must be placed in D register, as this is
-//       canonical operator return location
+// NOTE: truth value indicator overwrites x at the top of the stack, as this
+//       is where operators leave their result
 void CodeWriter::WriteComparison(const std::string& op) {
-    outFile << "D=A-D\n";
-    outFile << "@EQ" << jumpIndex << '\n';
-    outFile << "D;" << op << '\n';
-    outFile << "@SP\n";
-    outFile << "A=M\n";
-    outFile << "D=0\n";
-    outFile << "@TERM" << jumpIndex << '\n';
-    outFile << "0;JMP\n";
-    outFile << "(EQ" << jumpIndex << ")\n";
-    outFile << "@SP\n";
-    outFile << "A=M\n";
-    outFile << "D=-1\n";
-    outFile << "(TERM" << jumpIndex << ")\n";
+    EmitCompute("D=M-D");
+    EmitAddress("EQ" + std::to_string(jumpIndex));
+    EmitCompute("D;" + op);
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("M=0");
+    EmitAddress("TERM" + std::to_string(jumpIndex));
+    EmitCompute("0;JMP");
+    EmitLabel("EQ" + std::to_string(jumpIndex));
+    EmitAddress("SP");
+    EmitCompute("A=M-1");
+    EmitCompute("M=-1");
+    EmitLabel("TERM" + std::to_string(jumpIndex));
 
     ++jumpIndex;
 }
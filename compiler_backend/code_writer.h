@@ -1,16 +1,25 @@
 #ifndef CODE_WRITER_H
 #define CODE_WRITER_H
 
+#include "code_stats.h"
+#include "instruction_sink.h"
 #include "parser.h"
 
 #include <map>
+#include <memory>
 #include <set>
 #include <stack>
 #include <string>
+#include <string_view>
 
 class CodeWriter {
   public:
-    CodeWriter(const std::string& outName);
+    // textual assembly or machine code from the built-in assembler
+    enum class OutputFormat { ASM, HACK };
+
+    CodeWriter(const std::string& outName,
+               const OutputFormat format = OutputFormat::ASM);
+    CodeWriter(std::unique_ptr<InstructionSink> sink);
 
     // delete unwanted constructors
     CodeWriter(const CodeWriter& that) = delete;
@@ -18,7 +27,9 @@ class CodeWriter {
     CodeWriter& operator=(const CodeWriter& that) = delete;
     CodeWriter& operator=(const CodeWriter&& that) = delete;
 
-    void SetFileName(const std::string& fname) { infileName = fname; }
+    void SetFileName(const std::string& fname);
+    void SetInlineMath(const bool enable) { inlineMath = enable; }
+    void SetStats(CodeStats* collector) { stats = collector; }
     void WriteInit();
     void WriteArithmetic(const std::string& command);
     void WritePushPop(const Command ptype, const std::string& segment,
@@ -29,14 +40,37 @@ class CodeWriter {
     void WriteCall(const std::string& functionName, int nArgs);
     void WriteFunction(const std::string& functionName, int nLocals);
     void WriteReturn();
+    void WritePreserves(const uint8_t flags) { pendingPreserved = flags; }
+    void Close();
 
   private:
+    // commands held back so they can be fused with the one that follows
+    enum class Deferred { NONE, CALL, PUSH_CONSTANT, COMPARISON };
+
     int jumpIndex;
     int returnIndex;
-    std::ofstream outFile;
+    std::unique_ptr<InstructionSink> out;
+    CodeStats* stats;
     std::string infileName;
     std::string currFunction;
 
+    // vmb::Preserved flags announced for the next function, and those of the
+    // current one
+    uint8_t pendingPreserved;
+    uint8_t preserved;
+
+    Deferred deferred;
+    std::string deferredName;
+    int deferredArg;
+    bool deferredConstOperand;
+    bool deferredNegated;
+
+    // shared runtime routines are only written out if some command used them
+    bool inlineMath;
+    bool usesTailCall;
+    bool usesMultiply;
+    bool usesDivide;
+
     const std::string pushCommand = "push";
     const std::string popCommand = "pop";
 
@@ -52,24 +86,62 @@ class CodeWriter {
 
     const int savedStackSize = 5;
 
+    // multiplication by a constant with at most this many set bits is
+    // expanded inline instead of calling the shared routine
+    const int maxInlineMultiplyBits = 4;
+
+    // pops to segment offsets up to this are addressed by stepping A, larger
+    // offsets compute the address into R13 first
+    const int maxStepOffset = 7;
+
+    const std::string multiplyFunction = "Math.multiply";
+    const std::string divideFunction = "Math.divide";
+
     const std::set<std::string> binaryCommands = {"add", "sub", "eq", "gt",
                                                   "lt",  "and", "or"};
 
     const std::set<std::string> unaryCommands = {"neg", "not"};
 
+    // jump taken when comparison (or its negation) holds for x - y
+    const std::map<std::string, std::string> jumpConditions = {
+        {"eq", "JEQ"}, {"gt", "JGT"}, {"lt", "JLT"}};
+    const std::map<std::string, std::string> negatedJumpConditions = {
+        {"eq", "JNE"}, {"gt", "JLE"}, {"lt", "JGE"}};
+
     const std::map<std::string, std::string> regMap = {{"local", "LCL"},
                                                        {"argument", "ARG"},
                                                        {"this", "THIS"},
                                                        {"that", "THAT"}};
 
     // methods
+    static std::unique_ptr<InstructionSink> MakeSink(
+        const std::string& outName, const OutputFormat format);
+
+    void EmitAddress(const int value);
+    void EmitAddress(const std::string& symbol);
+    void EmitCompute(const std::string_view instr);
+    void EmitLabel(const std::string& symbol);
+    void Tag(const std::string& opcode);
+    void Tag(const std::string& opcode, const std::string& function);
+
+    void FlushDeferred();
+    void EmitCall(const std::string& functionName, int nArgs);
+    void PushCallFrame(int nArgs);
+    void EmitComparisonJump(const std::string& label);
+    void EmitTailCall(const std::string& functionName, int nArgs);
+    void EmitRoutineCall(const std::string& routine);
+    void EmitConstantMultiply(const int factor);
+    void WriteTailCallHelper();
+    void WriteMultiplyHelper();
+    void WriteDivideHelper();
     void WritePush(const std::string& segment, const int index);
     void PushFixed(const std::string& segment, const int index, const int base,
                    const int maxOffset);
     void WritePop(const std::string& segment, const int index);
     void PopFixed(const std::string& segment, const int index, const int base,
                   const int maxOffset);
-    void PopFrame(const std::string& reg);
+    void PopFrame(const std::string& reg, const int skipped);
+    void RestoreFrameRegister(const std::string& reg, const int offset);
     void WriteBinaryOp(const std::string& command);
     void WriteUnaryOp(const std::string& command);
     void WriteOpCommand(const std::string& command);
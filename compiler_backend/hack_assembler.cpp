@@ -0,0 +1,111 @@
+#include "hack_assembler.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+/* -------------------------------------------------------------------------- */
+
+HackAssembler::HackAssembler(const std::string& outFileName) :
+        outName(outFileName),
+        rom(),
+        symbolIds(),
+        symbolValues(),
+        fixups() {}
+
+/* -------------------------------------------------------------------------- */
+
+void HackAssembler::Address(const int value) {
+    if (value < 0 || value > maxAddress) {
+        std::cerr << "ERROR: Address " << value << " out of range\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    rom.push_back(static_cast<uint16_t>(value));
+}
+
+/* -------------------------------------------------------------------------- */
+
+void HackAssembler::Address(const std::string& symbol) {
+    auto predefined = predefinedSymbols.find(symbol);
+    if (predefined != predefinedSymbols.end()) {
+        rom.push_back(static_cast<uint16_t>(predefined->second));
+        return;
+    }
+
+    fixups.push_back({rom.size(), SymbolId(symbol)});
+    rom.push_back(0);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void HackAssembler::Compute(const uint16_t code) { rom.push_back(code); }
+
+/* -------------------------------------------------------------------------- */
+
+void HackAssembler::Label(const std::string& symbol) {
+    const size_t id = SymbolId(symbol);
+
+    if (symbolValues[id] != -1) {
+        std::cerr << "ERROR: Label " << symbol << " defined more than once\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    symbolValues[id] = static_cast<int>(rom.size());
+}
+
+/* -------------------------------------------------------------------------- */
+
+void HackAssembler::Finish() {
+    if (rom.size() > static_cast<size_t>(maxAddress) + 1) {
+        // labels past the end could not be encoded as A-instructions
+        std::cerr << "ERROR: Program of " << rom.size()
+                  << " instructions does not fit in ROM\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // anything still undefined is a variable
+    int nextVariable = firstVariable;
+    for (const auto& fixup : fixups) {
+        int& value = symbolValues[fixup.second];
+        if (value == -1) {
+            value = nextVariable;
+            ++nextVariable;
+        }
+
+        rom[fixup.first] = static_cast<uint16_t>(value);
+    }
+
+    std::string text;
+    text.reserve(rom.size() * 17);
+
+    for (const uint16_t word : rom) {
+        for (int bit = 15; bit >= 0; --bit) {
+            text += ((word >> bit) & 1) ? '1' : '0';
+        }
+        text += '\n';
+    }
+
+    std::ofstream outFile(outName);
+    if (!outFile.is_open()) {
+        std::cerr << "ERROR: Could not open output file " << outName << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+
+    outFile << text;
+}
+
+/* -------------------------------------------------------------------------- */
+
+size_t HackAssembler::SymbolId(const std::string& symbol) {
+    auto entry = symbolIds.find(symbol);
+    if (entry != symbolIds.end()) return entry->second;
+
+    const size_t id = symbolValues.size();
+    symbolIds.insert({symbol, id});
+    symbolValues.push_back(-1);
+
+    return id;
+}
+
+/* -------------------------------------------------------------------------- */
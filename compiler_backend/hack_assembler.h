@@ -0,0 +1,59 @@
+#ifndef HACK_ASSEMBLER_H
+#define HACK_ASSEMBLER_H
+
+#include "instruction_sink.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// In-memory assembler writing Hack machine code (.hack). Instructions are
+// collected as 16-bit words; symbolic addresses are recorded as fixups and
+// resolved once all labels are known, using the same rules as the standalone
+// assembler (labels, then variables allocated from RAM[16] in order of first
+// use).
+class HackAssembler : public InstructionSink {
+  public:
+    HackAssembler(const std::string& outFileName);
+
+    // delete unwanted constructors
+    HackAssembler(const HackAssembler& that) = delete;
+    HackAssembler(const HackAssembler&& that) = delete;
+    HackAssembler& operator=(const HackAssembler& that) = delete;
+    HackAssembler& operator=(const HackAssembler&& that) = delete;
+
+    void Address(const int value) override;
+    void Address(const std::string& symbol) override;
+    void Compute(const uint16_t code) override;
+    void Label(const std::string& symbol) override;
+    void Finish() override;
+
+  private:
+    std::string outName;
+
+    std::vector<uint16_t> rom;
+
+    // symbol ids index symbolValues, -1 if not yet known
+    std::unordered_map<std::string, size_t> symbolIds;
+    std::vector<int> symbolValues;
+
+    // (ROM address, symbol id) of every symbolic A-instruction
+    std::vector<std::pair<size_t, size_t>> fixups;
+
+    const int maxAddress = 32767;
+    const int firstVariable = 16;
+
+    const std::unordered_map<std::string, int> predefinedSymbols = {
+        {"SP", 0},       {"LCL", 1},      {"ARG", 2},   {"THIS", 3},
+        {"THAT", 4},     {"R0", 0},       {"R1", 1},    {"R2", 2},
+        {"R3", 3},       {"R4", 4},       {"R5", 5},    {"R6", 6},
+        {"R7", 7},       {"R8", 8},       {"R9", 9},    {"R10", 10},
+        {"R11", 11},     {"R12", 12},     {"R13", 13},  {"R14", 14},
+        {"R15", 15},     {"SCREEN", 16384}, {"KBD", 24576}};
+
+    // methods
+    size_t SymbolId(const std::string& symbol);
+};
+
+#endif /* HACK_ASSEMBLER_H */
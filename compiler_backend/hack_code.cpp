@@ -0,0 +1,33 @@
+#include "hack_code.h"
+
+/* -------------------------------------------------------------------------- */
+
+std::string DecodeCompute(const uint16_t code) {
+    const uint16_t compBits = (code >> 6) & 0b1111111;
+    const uint16_t dest = (code >> 3) & 0b111;
+    const uint16_t jump = code & 0b111;
+
+    std::string instr;
+
+    if (dest & 0b100) instr += 'A';
+    if (dest & 0b001) instr += 'M';
+    if (dest & 0b010) instr += 'D';
+    if (dest != 0) instr += '=';
+
+    // first match is the canonical spelling
+    for (const auto& comp : hackCompCodes) {
+        if (comp.bits == compBits) {
+            instr += comp.mnemonic;
+            break;
+        }
+    }
+
+    if (jump != 0) {
+        instr += ';';
+        instr += hackJumpNames[jump];
+    }
+
+    return instr;
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,81 @@
+#ifndef HACK_CODE_H
+#define HACK_CODE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Binary encoding of Hack C-instructions: 111a cccc ccdd djjj
+//
+// Instructions are given in assembly form ("AM=M-1", "D;JGT", ...). Both the
+// canonical and the commuted spelling of symmetric operations are accepted,
+// e.g. "D+M" and "M+D". Unknown mnemonics encode to 0, which is never a valid
+// C-instruction.
+
+struct HackCompCode {
+    std::string_view mnemonic;
+    uint16_t bits;  // a bit followed by the six c bits
+};
+
+constexpr HackCompCode hackCompCodes[] = {
+    {"0", 0b0101010},   {"1", 0b0111111},   {"-1", 0b0111010},
+    {"D", 0b0001100},   {"A", 0b0110000},   {"!D", 0b0001101},
+    {"!A", 0b0110001},  {"-D", 0b0001111},  {"-A", 0b0110011},
+    {"D+1", 0b0011111}, {"A+1", 0b0110111}, {"D-1", 0b0001110},
+    {"A-1", 0b0110010}, {"D+A", 0b0000010}, {"D-A", 0b0010011},
+    {"A-D", 0b0000111}, {"D&A", 0b0000000}, {"D|A", 0b0010101},
+    {"M", 0b1110000},   {"!M", 0b1110001},  {"-M", 0b1110011},
+    {"M+1", 0b1110111}, {"M-1", 0b1110010}, {"D+M", 0b1000010},
+    {"D-M", 0b1010011}, {"M-D", 0b1000111}, {"D&M", 0b1000000},
+    {"D|M", 0b1010101},
+    // commuted forms, never produced by DecodeCompute
+    {"A+D", 0b0000010}, {"M+D", 0b1000010}, {"A&D", 0b0000000},
+    {"M&D", 0b1000000}, {"A|D", 0b0010101}, {"M|D", 0b1010101},
+    {"1+D", 0b0011111}, {"1+A", 0b0110111}, {"1+M", 0b1110111}};
+
+constexpr std::string_view hackJumpNames[] = {"",    "JGT", "JEQ", "JGE",
+                                              "JLT", "JNE", "JLE", "JMP"};
+
+constexpr uint16_t EncodeCompute(std::string_view instr) {
+    uint16_t dest = 0;
+    const auto equalPos = instr.find('=');
+    if (equalPos != std::string_view::npos) {
+        for (const char c : instr.substr(0, equalPos)) {
+            if (c == 'A') {
+                dest |= 0b100;
+            } else if (c == 'D') {
+                dest |= 0b010;
+            } else if (c == 'M') {
+                dest |= 0b001;
+            } else {
+                return 0;
+            }
+        }
+        instr.remove_prefix(equalPos + 1);
+    }
+
+    uint16_t jump = 0;
+    const auto semiPos = instr.find(';');
+    if (semiPos != std::string_view::npos) {
+        const auto jumpName = instr.substr(semiPos + 1);
+        for (uint16_t j = 1; j < 8; ++j) {
+            if (hackJumpNames[j] == jumpName) jump = j;
+        }
+        if (jump == 0) return 0;
+        instr = instr.substr(0, semiPos);
+    }
+
+    for (const auto& comp : hackCompCodes) {
+        if (comp.mnemonic == instr) {
+            return static_cast<uint16_t>(0b111 << 13 | comp.bits << 6 |
+                                         dest << 3 | jump);
+        }
+    }
+
+    return 0;
+}
+
+// canonical assembly form of an encoded C-instruction
+std::string DecodeCompute(const uint16_t code);
+
+#endif /* HACK_CODE_H */
@@ -0,0 +1,23 @@
+#ifndef INSTRUCTION_SINK_H
+#define INSTRUCTION_SINK_H
+
+#include <cstdint>
+#include <string>
+
+// Destination for the Hack instructions produced by CodeWriter. Compute
+// instructions arrive already encoded (see hack_code.h); addresses may be
+// numeric or symbolic, with symbols resolved by the sink.
+class InstructionSink {
+  public:
+    virtual ~InstructionSink() = default;
+
+    virtual void Address(const int value) = 0;
+    virtual void Address(const std::string& symbol) = 0;
+    virtual void Compute(const uint16_t code) = 0;
+    virtual void Label(const std::string& symbol) = 0;
+
+    // called once after the last instruction
+    virtual void Finish() = 0;
+};
+
+#endif /* INSTRUCTION_SINK_H */
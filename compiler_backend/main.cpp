@@ -1,3 +1,4 @@
+#include "code_stats.h"
 #include "code_writer.h"
 #include "parser.h"
 
@@ -6,25 +7,63 @@
 
 namespace fs = std::filesystem;
 
-const std::string outExt = ".asm";
+const std::string inExt = ".vm";
+const std::string binaryInExt = ".vmb";
+const std::string asmExt = ".asm";
+const std::string hackExt = ".hack";
 
+// options
+const std::string noInlineMathFlag = "--no-inline-math";
+const std::string hackFlag = "--hack";
+const std::string statsFlag = "--stats";
+const std::string statsJSONFlag = "--stats-json";
+
+void PrintUsage(const std::string& progName);
 void TranslateVMFile(Parser& parser, CodeWriter& writer);
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <.vm file or directory>\n";
-        std::exit(EXIT_FAILURE);
+    std::string inputName = "";
+    bool inlineMath = true;
+    auto format = CodeWriter::OutputFormat::ASM;
+    bool printStats = false;
+    bool statsAsJSON = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == noInlineMathFlag) {
+            inlineMath = false;
+        } else if (arg == hackFlag) {
+            format = CodeWriter::OutputFormat::HACK;
+        } else if (arg == statsFlag) {
+            printStats = true;
+        } else if (arg == statsJSONFlag) {
+            printStats = true;
+            statsAsJSON = true;
+        } else if (inputName.empty()) {
+            inputName = arg;
+        } else {
+            PrintUsage(argv[0]);
+        }
     }
 
-    fs::path inputPath(argv[1]);
+    if (inputName.empty()) PrintUsage(argv[0]);
+
+    CodeStats stats;
+
+    fs::path inputPath(inputName);
     std::string outName = "";
+    const std::string outExt =
+        (format == CodeWriter::OutputFormat::HACK) ? hackExt : asmExt;
 
     if (fs::exists(inputPath)) {
         if (fs::is_regular_file(inputPath)) {
             outName = inputPath.stem();
             outName += outExt;
 
-            CodeWriter writer(outName);
+            CodeWriter writer(outName, format);
+            writer.SetInlineMath(inlineMath);
+            if (printStats) writer.SetStats(&stats);
             writer.SetFileName(inputPath.stem());
             Parser parser(inputPath.filename());
 
@@ -32,6 +71,8 @@ int main(int argc, char* argv[]) {
 
             TranslateVMFile(parser, writer);
 
+            writer.Close();
+
         } else if (fs::is_directory(inputPath)) {
             // assumes translator is called on relative path of dir
             // i.e. using -> ./VMTranslator mydir
@@ -39,16 +80,24 @@ int main(int argc, char* argv[]) {
             outName = tempPath;
             outName += outExt;
 
-            CodeWriter writer(outName);
+            CodeWriter writer(outName, format);
+            writer.SetInlineMath(inlineMath);
+            if (printStats) writer.SetStats(&stats);
 
             writer.WriteInit();
 
             for (auto& p : fs::directory_iterator(inputPath)) {
+                // skip earlier output in the same directory
+                const auto ext = p.path().extension();
+                if (ext != inExt && ext != binaryInExt) continue;
+
                 Parser parser(p.path());
                 writer.SetFileName(p.path().stem());
                 TranslateVMFile(parser, writer);
             }
 
+            writer.Close();
+
             // move temporary file to final destination
             fs::path oldPath(outName);
             fs::path finalPath = inputPath.parent_path() / outName;
@@ -57,10 +106,20 @@ int main(int argc, char* argv[]) {
         } else {
             std::cerr << "ERROR: Unsupported file type for " << inputPath
                       << '\n';
+            return 0;
         }
 
     } else {
         std::cerr << inputPath << " does not exist\n";
+        return 0;
+    }
+
+    if (printStats) {
+        if (statsAsJSON) {
+            stats.PrintJSON(std::cout);
+        } else {
+            stats.PrintReport(std::cout);
+        }
     }
 
     return 0;
@@ -68,6 +127,23 @@ int main(int argc, char* argv[]) {
 
 /* -------------------------------------------------------------------------- */
 
+void PrintUsage(const std::string& progName) {
+    std::cerr << "Usage: " << progName << " <.vm/.vmb file or directory> ["
+              << hackFlag << "] [" << noInlineMathFlag << "] [" << statsFlag
+              << " | " << statsJSONFlag << "]\n";
+    std::cerr << "  " << hackFlag
+              << "            write machine code instead of assembly\n";
+    std::cerr << "  " << noInlineMathFlag
+              << "  always call Math.multiply and Math.divide\n";
+    std::cerr << "  " << statsFlag
+              << "           print ROM size and cycle estimates per function\n";
+    std::cerr << "  " << statsJSONFlag
+              << "      print the same report as JSON\n";
+    std::exit(EXIT_FAILURE);
+}
+
+/* -------------------------------------------------------------------------- */
+
 void TranslateVMFile(Parser& parser, CodeWriter& writer) {
     while (parser.Advance()) {
         if (parser.CommandText() == "") continue;
@@ -78,7 +154,7 @@ void TranslateVMFile(Parser& parser, CodeWriter& writer) {
 
         } else if (currCommand == Command::PUSH ||
                    currCommand == Command::POP) {
-            int index = std::stoi(parser.SecondArg());
+            int index = parser.SecondArgValue();
             writer.WritePushPop(currCommand, parser.FirstArg(), index);
 
         } else if (currCommand == Command::LABEL) {
@@ -91,16 +167,19 @@ void TranslateVMFile(Parser& parser, CodeWriter& writer) {
             writer.WriteIf(parser.FirstArg());
 
         } else if (currCommand == Command::FUNCTION) {
-            int nLocals = std::stoi(parser.SecondArg());
+            int nLocals = parser.SecondArgValue();
             writer.WriteFunction(parser.FirstArg(), nLocals);
 
         } else if (currCommand == Command::CALL) {
-            int nArgs = std::stoi(parser.SecondArg());
+            int nArgs = parser.SecondArgValue();
             writer.WriteCall(parser.FirstArg(), nArgs);
 
         } else if (currCommand == Command::RETURN) {
             writer.WriteReturn();
 
+        } else if (currCommand == Command::PRESERVES) {
+            writer.WritePreserves(parser.PreservedFlags());
+
         } else {
             std::cerr << "WARNING: Unsupported command type\n";
         }
@@ -1,5 +1,12 @@
 #include "parser.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 
 using tokenizer = boost::tokenizer<boost::char_separator<char> >;
@@ -7,12 +14,27 @@ using tokenizer = boost::tokenizer<boost::char_separator<char> >;
 /* -------------------------------------------------------------------------- */
 
 Parser::Parser(const std::string& fileName) :
-        inFile(fileName),
+        inFile(),
         currLine(),
         command(),
         arg1(),
         arg2(),
+        binary(false),
+        mapBegin(nullptr),
+        mapPos(nullptr),
+        mapEnd(nullptr),
+        stringTable(),
+        binaryCommand(&command),
+        binaryArg1(&arg1),
+        arg2Value(0),
         sep(" \t\r\n") {
+    if (std::filesystem::path(fileName).extension() == binaryExt) {
+        OpenBinary(fileName);
+        return;
+    }
+
+    inFile.open(fileName);
+
     if (!inFile.is_open()) {
         std::cerr << "ERROR: Could not open file \"" << fileName << "\"\n";
         std::exit(EXIT_FAILURE);
@@ -21,7 +43,73 @@ Parser::Parser(const std::string& fileName) :
 
 /* -------------------------------------------------------------------------- */
 
+Parser::~Parser() {
+    if (mapBegin) {
+        munmap(const_cast<uint8_t*>(mapBegin),
+               static_cast<size_t>(mapEnd - mapBegin));
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// maps the whole file and reads its string table, commands are decoded in
+// place as the parser advances
+void Parser::OpenBinary(const std::string& fileName) {
+    binary = true;
+
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat info;
+
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "ERROR: Could not open file \"" << fileName << "\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    const size_t size = static_cast<size_t>(info.st_size);
+
+    if (size > 0) {
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            std::cerr << "ERROR: Could not map file \"" << fileName << "\"\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        mapBegin = static_cast<const uint8_t*>(data);
+    }
+
+    close(fd);
+
+    mapPos = mapBegin;
+    mapEnd = mapBegin + size;
+
+    if (size < vmb::magicSize ||
+        std::memcmp(mapBegin, vmb::magic, vmb::magicSize) != 0) {
+        BinaryError("missing VMB1 header in \"" + fileName + "\"");
+    }
+
+    mapPos += vmb::magicSize;
+
+    const unsigned count = ReadVarint();
+    stringTable.reserve(count);
+
+    for (unsigned i = 0; i < count; ++i) {
+        const unsigned length = ReadVarint();
+
+        if (length > static_cast<size_t>(mapEnd - mapPos)) {
+            BinaryError("string table runs past end of file");
+        }
+
+        stringTable.emplace_back(reinterpret_cast<const char*>(mapPos), length);
+        mapPos += length;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
 bool Parser::Advance() {
+    if (binary) return AdvanceBinary();
+
     std::getline(inFile, currLine);
 
     if (!inFile.good()) return false;
@@ -29,9 +117,26 @@ bool Parser::Advance() {
     size_t commentPos = currLine.find(commentInitializer);
     std::string workingLine = currLine.substr(0, commentPos);
 
+    // a comment line starting with an annotation is read as that command,
+    // so that other VM tools simply skip it
+    if (commentPos != std::string::npos &&
+        workingLine.find_first_not_of(" \t") == std::string::npos) {
+        const std::string comment =
+            currLine.substr(commentPos + commentInitializer.size());
+        tokenizer commentTok(comment, sep);
+
+        if (commentTok.begin() != commentTok.end() &&
+            annotations.count(*commentTok.begin())) {
+            workingLine = comment;
+        }
+    }
+
     tokenizer tok(workingLine, sep);
     auto tokIter = tok.begin();
 
+    arg1.clear();
+    arg2.clear();
+
     if (tok.begin() == tok.end()) {
         command = "";
 
@@ -56,17 +161,19 @@ bool Parser::Advance() {
 /* -------------------------------------------------------------------------- */
 
 Command Parser::CommandType() {
-    if (arithmeticCommands.find(command) != arithmeticCommands.end()) {
+    const std::string& name = CommandText();
+
+    if (arithmeticCommands.find(name) != arithmeticCommands.end()) {
         return Command::ARITHMETIC;
 
-    } else if (controlCommands.find(command) != controlCommands.end()) {
-        return controlCommands.at(command);
+    } else if (controlCommands.find(name) != controlCommands.end()) {
+        return controlCommands.at(name);
 
-    } else if (command.empty()) {
+    } else if (name.empty()) {
         return Command::EMPTY;
 
     } else {
-        std::cerr << "WARNING: Unrecognized VM command \"" << command << "\"\n";
+        std::cerr << "WARNING: Unrecognized VM command \"" << name << "\"\n";
     }
 
     return Command::UNKNOWN;
@@ -74,14 +181,128 @@ Command Parser::CommandType() {
 
 /* -------------------------------------------------------------------------- */
 
-std::string Parser::CommandText() { return command; }
+bool Parser::AdvanceBinary() {
+    if (mapPos == mapEnd) return false;
+
+    const uint8_t opcode = ReadByte();
+    const auto name = binaryCommands.find(opcode);
+
+    if (name == binaryCommands.end()) {
+        BinaryError("unknown opcode " + std::to_string(static_cast<int>(opcode)));
+    }
+
+    binaryCommand = &name->second;
+    binaryArg1 = &arg1;
+
+    if (opcode == vmb::PUSH || opcode == vmb::POP) {
+        const uint8_t segment = ReadByte();
+
+        if (segment > vmb::TEMP) {
+            BinaryError("unknown segment " + std::to_string(static_cast<int>(segment)));
+        }
+
+        binaryArg1 = &vmb::segmentNames[segment];
+        arg2Value = static_cast<int>(ReadVarint());
+
+    } else if (opcode == vmb::LABEL || opcode == vmb::GOTO ||
+               opcode == vmb::IF_GOTO) {
+        binaryArg1 = &ReadString();
+
+    } else if (opcode == vmb::FUNCTION || opcode == vmb::CALL) {
+        binaryArg1 = &ReadString();
+        arg2Value = static_cast<int>(ReadVarint());
+
+    } else if (opcode == vmb::PRESERVES) {
+        arg2Value = ReadByte();
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+uint8_t Parser::ReadByte() {
+    if (mapPos == mapEnd) BinaryError("unexpected end of file");
+
+    return *mapPos++;
+}
+
+/* -------------------------------------------------------------------------- */
+
+unsigned Parser::ReadVarint() {
+    unsigned value = 0;
+
+    for (unsigned shift = 0; shift < 32; shift += 7) {
+        const uint8_t byte = ReadByte();
+        value |= static_cast<unsigned>(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0) return value;
+    }
+
+    BinaryError("varint too long");
+}
+
+/* -------------------------------------------------------------------------- */
+
+const std::string& Parser::ReadString() {
+    const unsigned id = ReadVarint();
+
+    if (id >= stringTable.size()) {
+        BinaryError("string id " + std::to_string(id) + " out of range");
+    }
+
+    return stringTable[id];
+}
+
+/* -------------------------------------------------------------------------- */
+
+void Parser::BinaryError(const std::string& msg) {
+    std::cerr << "ERROR: Malformed binary VM file: " << msg << '\n';
+    std::exit(EXIT_FAILURE);
+}
 
 /* -------------------------------------------------------------------------- */
 
-std::string Parser::FirstArg() { return arg1; }
+const std::string& Parser::CommandText() {
+    return binary ? *binaryCommand : command;
+}
 
 /* -------------------------------------------------------------------------- */
 
-std::string Parser::SecondArg() { return arg2; }
+const std::string& Parser::FirstArg() { return binary ? *binaryArg1 : arg1; }
+
+/* -------------------------------------------------------------------------- */
+
+std::string Parser::SecondArg() {
+    return binary ? std::to_string(arg2Value) : arg2;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int Parser::SecondArgValue() { return binary ? arg2Value : std::stoi(arg2); }
+
+/* -------------------------------------------------------------------------- */
+
+// flags of a preserves command, named by its words in text
+uint8_t Parser::PreservedFlags() {
+    if (binary) return static_cast<uint8_t>(arg2Value);
+
+    uint8_t flags = 0;
+
+    for (const auto& word : {arg1, arg2}) {
+        if (word == "this") {
+            flags |= vmb::PRESERVE_THIS;
+
+        } else if (word == "that") {
+            flags |= vmb::PRESERVE_THAT;
+
+        } else if (!word.empty()) {
+            std::cerr << "WARNING: Unrecognized preserved register \"" << word
+                      << "\"\n";
+        }
+    }
+
+    return flags;
+}
 
 /* -------------------------------------------------------------------------- */
@@ -1,12 +1,16 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "vm_binary.h"
+
 #include <boost/tokenizer.hpp>
 
+#include <cstdint>
 #include <fstream>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 enum class Command {
     ARITHMETIC,
@@ -18,6 +22,7 @@ enum class Command {
     FUNCTION,
     RETURN,
     CALL,
+    PRESERVES,
     EMPTY,
     UNKNOWN
 };
@@ -25,6 +30,7 @@ enum class Command {
 class Parser {
   public:
     Parser(const std::string& fileName);
+    ~Parser();
 
     // remove unwanted constructors
     Parser(const Parser& that) = delete;
@@ -34,9 +40,11 @@ class Parser {
 
     bool Advance();
     Command CommandType();
-    std::string CommandText();
-    std::string FirstArg();
+    const std::string& CommandText();
+    const std::string& FirstArg();
     std::string SecondArg();
+    int SecondArgValue();
+    uint8_t PreservedFlags();
 
   private:
     std::ifstream inFile;
@@ -46,9 +54,30 @@ class Parser {
     std::string arg1;
     std::string arg2;
 
+    // binary (.vmb) input, read in place from a read-only mapping. Names are
+    // copied into stringTable once when the file is opened; each command
+    // then refers to its name and first argument without copying them.
+    bool binary;
+    const uint8_t* mapBegin;
+    const uint8_t* mapPos;
+    const uint8_t* mapEnd;
+    std::vector<std::string> stringTable;
+    const std::string* binaryCommand;
+    const std::string* binaryArg1;
+    int arg2Value;
+
+    void OpenBinary(const std::string& fileName);
+    bool AdvanceBinary();
+    uint8_t ReadByte();
+    unsigned ReadVarint();
+    const std::string& ReadString();
+    [[noreturn]] void BinaryError(const std::string& msg);
+
     boost::char_separator<char> sep;
 
     const std::string commentInitializer = "//";
+    const std::set<std::string> annotations = {"preserves"};
+    const std::string binaryExt = ".vmb";
 
     const std::set<std::string> arithmeticCommands = {
         "add", "sub", "eq", "gt", "lt", "and", "or", "neg", "not"};
@@ -61,7 +90,19 @@ class Parser {
         {"if-goto", Command::IF},
         {"function", Command::FUNCTION},
         {"call", Command::CALL},
-        {"return", Command::RETURN}};
+        {"return", Command::RETURN},
+        {"preserves", Command::PRESERVES}};
+
+    const std::map<uint8_t, std::string> binaryCommands = {
+        {vmb::ADD, "add"},          {vmb::SUB, "sub"},
+        {vmb::NEG, "neg"},          {vmb::EQ, "eq"},
+        {vmb::GT, "gt"},            {vmb::LT, "lt"},
+        {vmb::AND, "and"},          {vmb::OR, "or"},
+        {vmb::NOT, "not"},          {vmb::PUSH, "push"},
+        {vmb::POP, "pop"},          {vmb::LABEL, "label"},
+        {vmb::GOTO, "goto"},        {vmb::IF_GOTO, "if-goto"},
+        {vmb::FUNCTION, "function"}, {vmb::CALL, "call"},
+        {vmb::RETURN, "return"},    {vmb::PRESERVES, "preserves"}};
 };
 
 #endif /* PARSER_H */
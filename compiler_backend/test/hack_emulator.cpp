@@ -0,0 +1,182 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal Hack CPU used by "make test". Runs a .hack file from address 0
+// until the program reaches a halt loop (an unconditional jump to the
+// A-instruction just before it) or runs off the end of ROM, then prints the
+// requested words of RAM on one line. The cycle count goes to stderr.
+class HackEmulator {
+  public:
+    HackEmulator(const std::string& hackName);
+
+    // remove unwanted constructors
+    HackEmulator(const HackEmulator& that) = delete;
+    HackEmulator(const HackEmulator&& that) = delete;
+    HackEmulator& operator=(const HackEmulator& that) = delete;
+    HackEmulator& operator=(const HackEmulator&& that) = delete;
+
+    // false if the program was still running after maxCycles
+    bool Run(const long maxCycles);
+
+    long Cycles() const { return cycles; }
+    int16_t Ram(const size_t address) const;
+
+  private:
+    std::vector<uint16_t> rom;
+    std::vector<uint16_t> ram;
+    uint16_t regA;
+    uint16_t regD;
+    size_t pc;
+    long cycles;
+
+    // SCREEN and KBD included
+    static constexpr size_t ramSize = 24577;
+    static constexpr uint16_t computeBit = 0x8000;
+
+    uint16_t Compute(const uint16_t instr) const;
+};
+
+/* -------------------------------------------------------------------------- */
+
+HackEmulator::HackEmulator(const std::string& hackName) :
+        rom(),
+        ram(ramSize, 0),
+        regA(0),
+        regD(0),
+        pc(0),
+        cycles(0) {
+    std::ifstream inFile(hackName);
+
+    if (!inFile.is_open()) {
+        std::cerr << "ERROR: Could not open file \"" << hackName << "\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::string line;
+    while (std::getline(inFile, line)) {
+        if (line.size() < 16) continue;
+        rom.push_back(static_cast<uint16_t>(std::stoul(line.substr(0, 16),
+                                                       nullptr, 2)));
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool HackEmulator::Run(const long maxCycles) {
+    while (pc < rom.size()) {
+        if (cycles == maxCycles) return false;
+        ++cycles;
+
+        const uint16_t instr = rom[pc];
+
+        if (!(instr & computeBit)) {
+            regA = instr;
+            ++pc;
+            continue;
+        }
+
+        const uint16_t result = Compute(instr);
+        const int16_t value = static_cast<int16_t>(result);
+        const size_t address = regA & 0x7fff;
+
+        // destination bits: A, D, M
+        if (instr & 0x8) {
+            if (address >= ramSize) {
+                std::cerr << "ERROR: Write to RAM[" << address << "] at "
+                          << pc << '\n';
+                std::exit(EXIT_FAILURE);
+            }
+            ram[address] = result;
+        }
+        if (instr & 0x10) regD = result;
+        if (instr & 0x20) regA = result;
+
+        // jump bits: less than, equal, greater than zero
+        const bool jump = ((instr & 0x4) && value < 0) ||
+                          ((instr & 0x2) && value == 0) ||
+                          ((instr & 0x1) && value > 0);
+
+        if (!jump) {
+            ++pc;
+            continue;
+        }
+
+        // @pc-1, 0;JMP
+        if ((instr & 0x7) == 0x7 && pc > 0 && address == pc - 1 &&
+            !(rom[pc - 1] & computeBit)) {
+            return true;
+        }
+
+        pc = address;
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int16_t HackEmulator::Ram(const size_t address) const {
+    return static_cast<int16_t>(ram.at(address));
+}
+
+/* -------------------------------------------------------------------------- */
+
+// ALU with control bits zx nx zy ny f no, y is M when the a bit is set
+uint16_t HackEmulator::Compute(const uint16_t instr) const {
+    const unsigned control = (instr >> 6) & 0x3f;
+
+    uint16_t x = regD;
+    uint16_t y = regA;
+
+    if (instr & 0x1000) {
+        const size_t address = regA & 0x7fff;
+        y = (address < ramSize) ? ram[address] : 0;
+    }
+
+    if (control & 0x20) x = 0;
+    if (control & 0x10) x = static_cast<uint16_t>(~x);
+    if (control & 0x08) y = 0;
+    if (control & 0x04) y = static_cast<uint16_t>(~y);
+
+    uint16_t out = (control & 0x02) ? static_cast<uint16_t>(x + y)
+                                    : static_cast<uint16_t>(x & y);
+    if (control & 0x01) out = static_cast<uint16_t>(~out);
+
+    return out;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, char* argv[]) {
+    if (argc != 4 && argc != 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <.hack file> <first address> <count> [max cycles]\n";
+        return EXIT_FAILURE;
+    }
+
+    const size_t first = std::stoul(argv[2]);
+    const size_t count = std::stoul(argv[3]);
+    const long maxCycles = (argc == 5) ? std::stol(argv[4]) : 100000000L;
+
+    HackEmulator emulator(argv[1]);
+
+    if (!emulator.Run(maxCycles)) {
+        std::cerr << "ERROR: Still running after " << maxCycles
+                  << " cycles\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << "cycles " << emulator.Cycles() << '\n';
+
+    for (size_t i = 0; i < count; ++i) {
+        std::cout << emulator.Ram(first + i) << (i + 1 < count ? ' ' : '\n');
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,80 @@
+#ifndef VM_BINARY_H
+#define VM_BINARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary form of a .vm file (.vmb), written by the Jack compiler with
+// --binary. Layout:
+//
+//   "VMB1"                       magic
+//   varint count                 string table (function and label names)
+//   { varint length, bytes }*
+//   command*                     until end of file
+//
+// Each command is one opcode byte followed by its operands:
+//
+//   arithmetic                   no operands
+//   push / pop                   segment byte, varint index
+//   label / goto / if-goto       varint string id
+//   function / call              varint string id, varint count
+//   return                       no operands
+//   preserves                    flag byte (PRESERVE_THIS | PRESERVE_THAT)
+//
+// Varints are unsigned LEB128: 7 bits per byte, low bits first, high bit set
+// on every byte but the last. The Jack compiler's VMWriter includes this
+// header as well, so both tools and the pipeline share one definition.
+
+namespace vmb {
+
+constexpr char magic[] = {'V', 'M', 'B', '1'};
+constexpr size_t magicSize = sizeof(magic);
+
+enum Opcode : uint8_t {
+    ADD = 0x00,
+    SUB = 0x01,
+    NEG = 0x02,
+    EQ = 0x03,
+    GT = 0x04,
+    LT = 0x05,
+    AND = 0x06,
+    OR = 0x07,
+    NOT = 0x08,
+    PUSH = 0x10,
+    POP = 0x11,
+    LABEL = 0x20,
+    GOTO = 0x21,
+    IF_GOTO = 0x22,
+    FUNCTION = 0x30,
+    CALL = 0x31,
+    RETURN = 0x32,
+    PRESERVES = 0x33
+};
+
+// flags of the "preserves" annotation, which comes just before a function
+// command and promises that the function never writes pointer 0 or 1 itself.
+// Its return then leaves that register as it is instead of restoring it from
+// the frame. In text it is written as the comment "// preserves this that"
+// (either word alone for one flag), which other VM tools ignore.
+enum Preserved : uint8_t { PRESERVE_THIS = 0x01, PRESERVE_THAT = 0x02 };
+
+enum Segment : uint8_t {
+    CONSTANT = 0,
+    ARGUMENT = 1,
+    LOCAL = 2,
+    STATIC = 3,
+    THIS = 4,
+    THAT = 5,
+    POINTER = 6,
+    TEMP = 7
+};
+
+// text spelling, indexed by Segment
+const std::string segmentNames[] = {"constant", "argument", "local",
+                                    "static",   "this",     "that",
+                                    "pointer",  "temp"};
+
+}  // namespace vmb
+
+#endif /* VM_BINARY_H */
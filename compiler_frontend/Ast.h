@@ -0,0 +1,211 @@
+#ifndef AST_H
+#define AST_H
+
+#include "VMWriter.h"
+
+#include <string>
+#include <vector>
+
+// Syntax tree built by CompilationEngine and walked by CodeGenerator. All
+// nodes are allocated from the AstArena of the file being compiled, so child
+// links are plain pointers. Variables are resolved against the symbol table
+// while parsing, since its subroutine scope is gone by the time code is
+// generated.
+
+// storage of a resolved variable
+struct VarRef {
+    VMWriter::Segment segment;
+    int index;
+};
+
+/* ------------------------------- expressions ------------------------------ */
+
+struct Expression {
+    enum Kind {
+        INT_CONST,
+        STRING_CONST,
+        KEYWORD_CONST,
+        VARIABLE,
+        ARRAY_ELEMENT,
+        CALL,
+        UNARY,
+        BINARY
+    };
+
+    const Kind kind;
+
+    explicit Expression(const Kind k) : kind(k) {}
+};
+
+struct IntConstant : Expression {
+    int value;
+
+    explicit IntConstant(const int v) : Expression(INT_CONST), value(v) {}
+};
+
+struct StringConstant : Expression {
+    std::string value;
+
+    explicit StringConstant(const std::string& v) :
+            Expression(STRING_CONST),
+            value(v) {}
+};
+
+struct KeywordConstant : Expression {
+    enum Value { TRUE_VALUE, FALSE_VALUE, NULL_VALUE, THIS_VALUE };
+
+    Value value;
+
+    explicit KeywordConstant(const Value v) :
+            Expression(KEYWORD_CONST),
+            value(v) {}
+};
+
+struct Variable : Expression {
+    VarRef var;
+
+    explicit Variable(const VarRef& v) : Expression(VARIABLE), var(v) {}
+};
+
+struct ArrayElement : Expression {
+    VarRef array;
+    Expression* index;
+
+    ArrayElement(const VarRef& a, Expression* i) :
+            Expression(ARRAY_ELEMENT),
+            array(a),
+            index(i) {}
+};
+
+struct SubroutineCall : Expression {
+    // what is pushed ahead of the arguments as the hidden "this" argument
+    enum Receiver { NONE, CURRENT_OBJECT, OBJECT_VARIABLE };
+
+    std::string name;  // full VM name, Class.subroutine
+    Receiver receiver;
+    VarRef object;  // only for OBJECT_VARIABLE
+    std::vector<Expression*> arguments;
+
+    SubroutineCall() :
+            Expression(CALL),
+            name(),
+            receiver(NONE),
+            object(),
+            arguments() {}
+};
+
+struct UnaryOp : Expression {
+    VMWriter::Command op;
+    Expression* operand;
+
+    UnaryOp(const VMWriter::Command o, Expression* x) :
+            Expression(UNARY),
+            op(o),
+            operand(x) {}
+};
+
+struct BinaryOp : Expression {
+    VMWriter::Command op;
+    Expression* left;
+    Expression* right;
+
+    BinaryOp(const VMWriter::Command o, Expression* x, Expression* y) :
+            Expression(BINARY),
+            op(o),
+            left(x),
+            right(y) {}
+};
+
+/* ------------------------------- statements ------------------------------- */
+
+struct Statement {
+    enum Kind { LET, IF, WHILE, DO, RETURN };
+
+    const Kind kind;
+
+    explicit Statement(const Kind k) : kind(k) {}
+};
+
+using StatementList = std::vector<Statement*>;
+
+struct LetStatement : Statement {
+    VarRef target;
+    Expression* index;  // nullptr unless assigning to an array element
+    Expression* value;
+
+    LetStatement(const VarRef& t, Expression* i, Expression* v) :
+            Statement(LET),
+            target(t),
+            index(i),
+            value(v) {}
+};
+
+struct IfStatement : Statement {
+    Expression* condition;
+    StatementList thenBody;
+    StatementList elseBody;
+
+    explicit IfStatement(Expression* c) :
+            Statement(IF),
+            condition(c),
+            thenBody(),
+            elseBody() {}
+};
+
+struct WhileStatement : Statement {
+    Expression* condition;
+    StatementList body;
+
+    explicit WhileStatement(Expression* c) :
+            Statement(WHILE),
+            condition(c),
+            body() {}
+};
+
+struct DoStatement : Statement {
+    SubroutineCall* call;
+
+    explicit DoStatement(SubroutineCall* c) : Statement(DO), call(c) {}
+};
+
+struct ReturnStatement : Statement {
+    Expression* value;  // nullptr for a bare return
+
+    explicit ReturnStatement(Expression* v) : Statement(RETURN), value(v) {}
+};
+
+/* -------------------------------- top level ------------------------------- */
+
+struct SubroutineDec {
+    enum Kind { CONSTRUCTOR, FUNCTION, METHOD };
+
+    Kind kind;
+    std::string name;  // full VM name, Class.subroutine
+    bool isVoid;
+    int nLocals;
+    int nFields;  // object size allocated by a constructor
+    bool fallsThrough;  // false if every path through the body returns
+    StatementList body;
+
+    SubroutineDec(const Kind k, const std::string& n, const bool v) :
+            kind(k),
+            name(n),
+            isVoid(v),
+            nLocals(0),
+            nFields(0),
+            fallsThrough(true),
+            body() {}
+};
+
+struct ClassDec {
+    std::string name;
+    int nStatics;  // static variables declared by the class
+    std::vector<SubroutineDec*> subroutines;
+
+    explicit ClassDec(const std::string& n) :
+            name(n),
+            nStatics(0),
+            subroutines() {}
+};
+
+#endif /* AST_H */
@@ -0,0 +1,48 @@
+#include "AstArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+/* -------------------------------------------------------------------------- */
+
+AstArena::AstArena() :
+        blocks(),
+        destructors(),
+        blockPos(nullptr),
+        blockRemaining(0) {}
+
+/* -------------------------------------------------------------------------- */
+
+AstArena::~AstArena() {
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+        it->destroy(it->node);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void* AstArena::Allocate(const size_t size, const size_t alignment) {
+    auto address = reinterpret_cast<uintptr_t>(blockPos);
+    size_t padding = (alignment - address % alignment) % alignment;
+
+    if (blockPos == nullptr || padding + size > blockRemaining) {
+        // oversized nodes get a block of their own
+        const size_t newSize = std::max(blockSize, size + alignment);
+
+        blocks.push_back(std::make_unique<std::byte[]>(newSize));
+        blockPos = blocks.back().get();
+        blockRemaining = newSize;
+
+        address = reinterpret_cast<uintptr_t>(blockPos);
+        padding = (alignment - address % alignment) % alignment;
+    }
+
+    std::byte* result = blockPos + padding;
+
+    blockPos = result + size;
+    blockRemaining -= padding + size;
+
+    return result;
+}
+
+/* -------------------------------------------------------------------------- */
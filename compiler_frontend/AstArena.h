@@ -0,0 +1,58 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for the syntax tree of one source file. Nodes are carved out
+// of large blocks and live until the arena is destroyed, at which point any
+// node with a destructor (strings, child lists) is cleaned up in reverse
+// order of creation.
+class AstArena {
+  public:
+    AstArena();
+    ~AstArena();
+
+    // remove unwanted constructors
+    AstArena(const AstArena& that) = delete;
+    AstArena(const AstArena&& that) = delete;
+    AstArena& operator=(const AstArena& that) = delete;
+    AstArena& operator=(const AstArena&& that) = delete;
+
+    template <typename T, typename... Args>
+    T* Make(Args&&... args) {
+        void* memory = Allocate(sizeof(T), alignof(T));
+        T* node = new (memory) T(std::forward<Args>(args)...);
+
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            destructors.push_back(
+                {node, [](void* p) { static_cast<T*>(p)->~T(); }});
+        }
+
+        return node;
+    }
+
+    // data
+  private:
+    struct Destructor {
+        void* node;
+        void (*destroy)(void*);
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::vector<Destructor> destructors;
+    std::byte* blockPos;
+    size_t blockRemaining;
+
+    const size_t blockSize = 16384;
+
+    // methods
+  private:
+    void* Allocate(const size_t size, const size_t alignment);
+};
+
+#endif /* AST_ARENA_H */
@@ -0,0 +1,224 @@
+#include "BuildManifest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+/* -------------------------------------------------------------------------- */
+
+BuildManifest::BuildManifest(const std::string& fileName,
+                             const std::string& options) :
+        manifestName(fileName),
+        optionsKey(options),
+        entries() {}
+
+/* -------------------------------------------------------------------------- */
+
+// Layout, one record per line:
+//
+//   jack-manifest 1
+//   options <compiler options>
+//   source <file name> <hash>
+//   class <class name>
+//   declares <subroutine> <kind> <nArgs> <return type>
+//   uses <class name> <interface hash>
+//
+// where the class, declares and uses lines belong to the source line above
+// them, and hashes are written in hex.
+void BuildManifest::Load() {
+    entries.clear();
+
+    std::ifstream inFile(manifestName);
+    std::string line;
+
+    if (!std::getline(inFile, line) || line != header) return;
+    if (!std::getline(inFile, line) || line != optionsTag + ' ' + optionsKey) {
+        return;
+    }
+
+    Entry* entry = nullptr;
+
+    while (std::getline(inFile, line)) {
+        std::istringstream fields(line);
+        std::string tag, name;
+        uint64_t hash = 0;
+        int kind = 0;
+        SignatureTable::Signature signature;
+
+        if (!(fields >> tag >> name)) {
+            entries.clear();
+            return;
+        }
+
+        if (tag == sourceTag && fields >> std::hex >> hash) {
+            entry = &entries[name];
+            entry->sourceHash = hash;
+
+        } else if (tag == classTag && entry) {
+            entry->className = name;
+
+        } else if (tag == signatureTag && entry &&
+                   fields >> kind >> signature.nArgs >> signature.returnType &&
+                   kind >= SubroutineDec::CONSTRUCTOR &&
+                   kind <= SubroutineDec::METHOD) {
+            signature.kind = static_cast<SubroutineDec::Kind>(kind);
+            entry->subroutines[name] = signature;
+
+        } else if (tag == dependencyTag && entry &&
+                   fields >> std::hex >> hash) {
+            entry->dependencies[name] = hash;
+
+        } else {
+            entries.clear();
+            return;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// written to a temporary file first, so an interrupted build never leaves a
+// half-written manifest behind
+void BuildManifest::Save() const {
+    const std::string tempName = manifestName + ".tmp";
+
+    {
+        std::ofstream outFile(tempName);
+        if (!outFile.is_open()) {
+            std::cerr << "WARNING: Could not write \"" << manifestName
+                      << "\"\n";
+            return;
+        }
+
+        outFile << header << '\n' << optionsTag << ' ' << optionsKey << '\n';
+
+        for (const auto& entry : entries) {
+            outFile << sourceTag << ' ' << entry.first << ' ' << std::hex
+                    << entry.second.sourceHash << std::dec << '\n';
+
+            if (!entry.second.className.empty()) {
+                outFile << classTag << ' ' << entry.second.className << '\n';
+            }
+
+            for (const auto& subroutine : entry.second.subroutines) {
+                const auto& signature = subroutine.second;
+                outFile << signatureTag << ' ' << subroutine.first << ' '
+                        << static_cast<int>(signature.kind) << ' '
+                        << signature.nArgs << ' ' << signature.returnType
+                        << '\n';
+            }
+
+            for (const auto& dependency : entry.second.dependencies) {
+                outFile << dependencyTag << ' ' << dependency.first << ' '
+                        << std::hex << dependency.second << std::dec << '\n';
+            }
+        }
+    }
+
+    std::rename(tempName.c_str(), manifestName.c_str());
+}
+
+/* -------------------------------------------------------------------------- */
+
+std::string BuildManifest::Restore(const std::string& source,
+                                   const uint64_t sourceHash,
+                                   SignatureTable& signatures) const {
+    const auto it = entries.find(source);
+    if (it == entries.end() || it->second.sourceHash != sourceHash) {
+        return "";
+    }
+
+    const Entry& entry = it->second;
+    if (!entry.className.empty()) {
+        signatures.AddClass(entry.className, entry.subroutines);
+    }
+
+    return entry.className;
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool BuildManifest::UpToDate(const std::string& source,
+                             const uint64_t sourceHash,
+                             const SignatureTable& signatures) const {
+    const auto it = entries.find(source);
+    if (it == entries.end() || it->second.sourceHash != sourceHash) {
+        return false;
+    }
+
+    for (const auto& dependency : it->second.dependencies) {
+        if (Hash(signatures.Interface(dependency.first)) != dependency.second) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void BuildManifest::Record(const std::string& source,
+                           const uint64_t sourceHash,
+                           const std::string& className,
+                           const std::set<std::string>& dependencies,
+                           const SignatureTable& signatures) {
+    Entry& entry = entries[source];
+    entry.sourceHash = sourceHash;
+    entry.className = className;
+    entry.subroutines.clear();
+    entry.dependencies.clear();
+
+    const auto subroutines = signatures.Subroutines(className);
+    if (subroutines) entry.subroutines = *subroutines;
+
+    for (const auto& dependency : dependencies) {
+        entry.dependencies[dependency] =
+            Hash(signatures.Interface(dependency));
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void BuildManifest::Forget(const std::string& source) { entries.erase(source); }
+
+/* -------------------------------------------------------------------------- */
+
+void BuildManifest::Prune(const std::set<std::string>& sources) {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (sources.find(it->first) == sources.end()) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+uint64_t BuildManifest::Hash(const std::string_view data) {
+    uint64_t hash = hashBasis;
+
+    for (const char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= hashPrime;
+    }
+
+    return hash;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// an unreadable file hashes as empty, compiling it reports the error
+uint64_t BuildManifest::HashFile(const std::string& fileName) {
+    std::ifstream inFile(fileName, std::ios::binary | std::ios::ate);
+    if (!inFile.is_open()) return Hash("");
+
+    std::string contents(static_cast<size_t>(inFile.tellg()), '\0');
+    inFile.seekg(0);
+    inFile.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+
+    return Hash(contents);
+}
+
+/* -------------------------------------------------------------------------- */
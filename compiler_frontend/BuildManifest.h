@@ -0,0 +1,78 @@
+#ifndef BUILD_MANIFEST_H
+#define BUILD_MANIFEST_H
+
+#include "SignatureTable.h"
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+
+// Record of the last incremental build of a directory, kept as a text file
+// next to the sources. For each source file it holds a hash of the source
+// that was compiled, the signatures the file declares, and a hash of the
+// interface (see SignatureTable::Interface) of every class its calls were
+// checked against. A file is up to date while its source and all of those
+// interfaces are unchanged, and the signatures of an unchanged file are
+// taken from here instead of scanning it again. The record is discarded if
+// it was written with other compiler options.
+class BuildManifest {
+  public:
+    BuildManifest(const std::string& fileName, const std::string& options);
+
+    // remove unwanted constructors
+    BuildManifest(const BuildManifest& that) = delete;
+    BuildManifest(const BuildManifest&& that) = delete;
+    BuildManifest& operator=(const BuildManifest& that) = delete;
+    BuildManifest& operator=(const BuildManifest&& that) = delete;
+
+    // a missing or unreadable manifest leaves every file out of date
+    void Load();
+    void Save() const;
+
+    // adds the recorded signatures of source to signatures if its hash is
+    // unchanged, and returns its class name; an empty string otherwise
+    std::string Restore(const std::string& source, const uint64_t sourceHash,
+                        SignatureTable& signatures) const;
+
+    bool UpToDate(const std::string& source, const uint64_t sourceHash,
+                  const SignatureTable& signatures) const;
+    void Record(const std::string& source, const uint64_t sourceHash,
+                const std::string& className,
+                const std::set<std::string>& dependencies,
+                const SignatureTable& signatures);
+    void Forget(const std::string& source);
+
+    // drops the entries of sources that no longer exist
+    void Prune(const std::set<std::string>& sources);
+
+    static uint64_t Hash(const std::string_view data);
+    static uint64_t HashFile(const std::string& fileName);
+
+    // data
+  private:
+    struct Entry {
+        uint64_t sourceHash;
+        std::string className;
+        SignatureTable::SubroutineMap subroutines;
+        std::map<std::string, uint64_t> dependencies;  // class -> interface
+    };
+
+    std::string manifestName;
+    std::string optionsKey;
+    std::map<std::string, Entry> entries;
+
+    const std::string header = "jack-manifest 1";
+    const std::string optionsTag = "options";
+    const std::string sourceTag = "source";
+    const std::string classTag = "class";
+    const std::string signatureTag = "declares";
+    const std::string dependencyTag = "uses";
+
+    // FNV-1a, 64 bit
+    static constexpr uint64_t hashBasis = 0xcbf29ce484222325ULL;
+    static constexpr uint64_t hashPrime = 0x100000001b3ULL;
+};
+
+#endif /* BUILD_MANIFEST_H */
@@ -0,0 +1,863 @@
+#include "CodeGenerator.h"
+#include "ConstantFolder.h"
+
+#include <cctype>
+
+/* -------------------------------------------------------------------------- */
+
+CodeGenerator::CodeGenerator(VMWriter& writer) :
+        vmWriter(writer),
+        loopCount(0),
+        branchCount(0),
+        skipCount(0),
+        stringCount(0),
+        sizeCheckCount(0),
+        poolBase(0),
+        stringPool(),
+        intrinsics(true),
+        thatValid(false),
+        thatBase(),
+        usesThis(false),
+        usesThat(false) {}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateClass(const ClassDec& classDec) {
+    poolBase = classDec.nStatics;
+    stringPool.clear();
+
+    for (const auto subroutine : classDec.subroutines) {
+        GenerateSubroutine(*subroutine);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateSubroutine(const SubroutineDec& subroutine) {
+    usesThis = false;
+    usesThat = false;
+    FindFrameUse(subroutine.body);
+
+    // only constructors and methods ever set pointer 0
+    const bool setsThis =
+        subroutine.kind == SubroutineDec::CONSTRUCTOR ||
+        (subroutine.kind == SubroutineDec::METHOD && usesThis);
+
+    vmWriter.WritePreserves(!setsThis, !usesThat);
+    vmWriter.WriteFunction(subroutine.name, subroutine.nLocals);
+    thatValid = false;
+
+    if (subroutine.kind == SubroutineDec::METHOD && usesThis) {
+        // need to align "this" segment with hidden arg
+        vmWriter.WritePush(VMWriter::ARG, 0);
+        vmWriter.WritePop(VMWriter::POINTER, 0);
+
+    } else if (subroutine.kind == SubroutineDec::CONSTRUCTOR) {
+        // need to allocate space for the object and store in "this" pointer
+        vmWriter.WritePush(VMWriter::CONST, subroutine.nFields);
+        vmWriter.WriteCall(allocFunction, 1);
+
+        vmWriter.WritePop(VMWriter::POINTER, 0);
+    }
+
+    GenerateStatements(subroutine.body);
+
+    // a body that can run off its end still needs a return
+    if (subroutine.fallsThrough) {
+        if (subroutine.isVoid) {
+            vmWriter.WritePush(VMWriter::CONST, 0);
+        }
+
+        vmWriter.WriteReturn();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateStatements(const StatementList& statements) {
+    for (const auto statement : statements) {
+        if (statement->kind == Statement::LET) {
+            GenerateLet(*static_cast<const LetStatement*>(statement));
+
+        } else if (statement->kind == Statement::IF) {
+            GenerateIf(*static_cast<const IfStatement*>(statement));
+
+        } else if (statement->kind == Statement::WHILE) {
+            GenerateWhile(*static_cast<const WhileStatement*>(statement));
+
+        } else if (statement->kind == Statement::DO) {
+            GenerateDo(*static_cast<const DoStatement*>(statement));
+
+        } else {
+            GenerateReturn(*static_cast<const ReturnStatement*>(statement));
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateLet(const LetStatement& statement) {
+    const auto& target = statement.target;
+    const auto& value = *statement.value;
+
+    if (!statement.index) {
+        GenerateExpression(value);
+        vmWriter.WritePop(target.segment, target.index);
+
+        // pointer 1 may hold the variable's old value
+        if (thatValid && thatBase.segment == target.segment &&
+            thatBase.index == target.index) {
+            thatValid = false;
+        }
+        return;
+    }
+
+    int offset = 0;
+    if (ConstantIndex(*statement.index, offset)) {
+        GenerateExpression(value);
+        LoadThatBase(target);
+        vmWriter.WritePop(VMWriter::THAT, offset);
+        return;
+    }
+
+    GenerateStore(&target, *statement.index, value);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// writes value to array[index], or to address index if there is no array
+void CodeGenerator::GenerateStore(const VarRef* array, const Expression& index,
+                                  const Expression& value) {
+    // calls and string literals may change pointer 1 as well as reading it
+    const unsigned thatKinds = KindBit(Expression::ARRAY_ELEMENT) |
+                               KindBit(Expression::STRING_CONST) |
+                               KindBit(Expression::CALL);
+    const unsigned effectKinds =
+        KindBit(Expression::STRING_CONST) | KindBit(Expression::CALL);
+
+    if (!ContainsKind(value, thatKinds)) {
+        // value leaves pointer 1 alone, so the address can be set first
+        LoadElementAddress(array, index);
+        GenerateExpression(value);
+        vmWriter.WritePop(VMWriter::THAT, 0);
+
+    } else if (!ContainsKind(index, effectKinds) &&
+               !ContainsKind(value, effectKinds)) {
+        // neither side has effects, so the value can be computed first
+        GenerateExpression(value);
+        LoadElementAddress(array, index);
+        vmWriter.WritePop(VMWriter::THAT, 0);
+
+    } else {
+        GenerateExpression(index);
+        GenerateExpression(value);
+
+        // hold return value
+        vmWriter.WritePop(VMWriter::TEMP, 1);
+
+        // current stack element is bracket expression, so add var val
+        if (array) {
+            vmWriter.WritePush(array->segment, array->index);
+            vmWriter.WriteArithmetic(VMWriter::ADD);
+        }
+
+        // move to "that" pointer
+        vmWriter.WritePop(VMWriter::POINTER, 1);
+        thatValid = false;
+
+        // get value from temp
+        vmWriter.WritePush(VMWriter::TEMP, 1);
+        vmWriter.WritePop(VMWriter::THAT, 0);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateIf(const IfStatement& statement) {
+    const auto myBranchCount = branchCount;
+    ++branchCount;
+
+    // jump to end of if branch if condition fails
+    const std::string midLabel =
+        "MID_" + branchBase + std::to_string(myBranchCount);
+    GenerateBranch(*statement.condition, midLabel, false);
+
+    GenerateStatements(statement.thenBody);
+
+    // without an else body the end of the if branch is the end of it all
+    if (statement.elseBody.empty()) {
+        PlaceLabel(midLabel);
+        return;
+    }
+
+    // jump to end of all blocks (including else), unless the if branch has
+    // already returned
+    const auto& thenBody = statement.thenBody;
+    const std::string endLabel =
+        endPrefix + branchBase + std::to_string(myBranchCount);
+    const bool thenReturns =
+        !thenBody.empty() && thenBody.back()->kind == Statement::RETURN;
+
+    if (!thenReturns) {
+        vmWriter.WriteGoto(endLabel);
+    }
+
+    // write label for end of if branch
+    PlaceLabel(midLabel);
+
+    GenerateStatements(statement.elseBody);
+
+    // label end of all blocks
+    if (!thenReturns) {
+        PlaceLabel(endLabel);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// loops are rotated: the test sits after the body and jumps back while the
+// condition holds, so an iteration runs one branch instead of a test, a not,
+// an exit branch and a jump back. The test is entered once from the top.
+void CodeGenerator::GenerateWhile(const WhileStatement& statement) {
+    const auto myLoopCount = loopCount;
+    ++loopCount;
+
+    const std::string loopID = loopBase + std::to_string(myLoopCount);
+    const std::string testLabel = testPrefix + loopID;
+
+    // the folder leaves -1 as the condition of a loop that always runs, which
+    // needs no test and has no exit
+    const auto& condition = *statement.condition;
+    const bool alwaysRuns =
+        condition.kind == Expression::INT_CONST &&
+        static_cast<const IntConstant&>(condition).value == -1;
+
+    if (!alwaysRuns) {
+        vmWriter.WriteGoto(testLabel);
+    }
+
+    // label loop body
+    PlaceLabel(loopID);
+
+    GenerateStatements(statement.body);
+
+    if (alwaysRuns) {
+        vmWriter.WriteGoto(loopID);
+        return;
+    }
+
+    // jump back to the body while the condition holds
+    PlaceLabel(testLabel);
+    GenerateBranch(condition, loopID, true);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// jumps to label if the condition's truth matches jumpIfTrue, otherwise
+// falls through. Jack tests a condition by jumping on "not condition", so
+// only -1 counts as true; conditions that can only be -1 or 0 are compiled
+// as control flow, anything else is compared against -1.
+//
+// & and | of such conditions become one branch per operand. The right
+// operand is skipped once the left one decides the outcome, which is only
+// done when evaluating it has no effect (see ConstantFolder::IsPure).
+void CodeGenerator::GenerateBranch(const Expression& condition,
+                                   const std::string& label,
+                                   const bool jumpIfTrue) {
+    if (condition.kind == Expression::INT_CONST ||
+        condition.kind == Expression::KEYWORD_CONST) {
+        if (IsBoolean(condition)) {
+            if (IsTrue(condition) == jumpIfTrue) {
+                vmWriter.WriteGoto(label);
+            }
+            return;
+        }
+
+    } else if (condition.kind == Expression::UNARY) {
+        const auto& unary = static_cast<const UnaryOp&>(condition);
+        if (unary.op == VMWriter::NOT && IsBoolean(*unary.operand)) {
+            GenerateBranch(*unary.operand, label, !jumpIfTrue);
+            return;
+        }
+
+    } else if (condition.kind == Expression::BINARY) {
+        const auto& binary = static_cast<const BinaryOp&>(condition);
+        const bool logical =
+            binary.op == VMWriter::AND || binary.op == VMWriter::OR;
+
+        if (logical && IsBoolean(*binary.left) && IsBoolean(*binary.right) &&
+            ConstantFolder::IsPure(binary.right)) {
+            // a false left operand decides "&", a true one decides "|"
+            const bool leftDecides = (binary.op == VMWriter::OR);
+
+            if (leftDecides == jumpIfTrue) {
+                GenerateBranch(*binary.left, label, jumpIfTrue);
+                GenerateBranch(*binary.right, label, jumpIfTrue);
+
+            } else {
+                const std::string skipLabel =
+                    skipBase + std::to_string(skipCount);
+                ++skipCount;
+
+                GenerateBranch(*binary.left, skipLabel, !jumpIfTrue);
+                GenerateBranch(*binary.right, label, jumpIfTrue);
+                PlaceLabel(skipLabel);
+            }
+            return;
+        }
+    }
+
+    GenerateExpression(condition);
+
+    // the translator fuses a comparison, an optional not and the if-goto
+    // into one jump
+    if (!IsBoolean(condition)) {
+        vmWriter.WriteArithmetic(VMWriter::NOT);
+        if (jumpIfTrue) {
+            vmWriter.WritePush(VMWriter::CONST, 0);
+            vmWriter.WriteArithmetic(VMWriter::EQ);
+        }
+
+    } else if (!jumpIfTrue) {
+        if (IsComparison(condition)) {
+            vmWriter.WriteArithmetic(VMWriter::NOT);
+        } else {
+            vmWriter.WritePush(VMWriter::CONST, 0);
+            vmWriter.WriteArithmetic(VMWriter::EQ);
+        }
+    }
+
+    vmWriter.WriteIf(label);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateDo(const DoStatement& statement) {
+    if (intrinsics && GenerateIntrinsic(*statement.call, false)) {
+        return;
+    }
+
+    GenerateCall(*statement.call);
+
+    // function is assumed void, so pop its value and ignore
+    vmWriter.WritePop(VMWriter::TEMP, 0);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateReturn(const ReturnStatement& statement) {
+    // void subroutines return 0
+    if (statement.value) {
+        GenerateExpression(*statement.value);
+    } else {
+        vmWriter.WritePush(VMWriter::CONST, 0);
+    }
+
+    vmWriter.WriteReturn();
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateExpression(const Expression& expression) {
+    if (expression.kind == Expression::INT_CONST) {
+        GenerateInt(static_cast<const IntConstant&>(expression).value);
+
+    } else if (expression.kind == Expression::STRING_CONST) {
+        GenerateStringBuild(
+            static_cast<const StringConstant&>(expression).value);
+
+    } else if (expression.kind == Expression::KEYWORD_CONST) {
+        GenerateKeyword(static_cast<const KeywordConstant&>(expression));
+
+    } else if (expression.kind == Expression::VARIABLE) {
+        const auto& var = static_cast<const Variable&>(expression).var;
+        vmWriter.WritePush(var.segment, var.index);
+
+    } else if (expression.kind == Expression::ARRAY_ELEMENT) {
+        GenerateArrayElement(static_cast<const ArrayElement&>(expression));
+
+    } else if (expression.kind == Expression::CALL) {
+        GenerateCall(static_cast<const SubroutineCall&>(expression));
+
+    } else if (expression.kind == Expression::UNARY) {
+        const auto& unary = static_cast<const UnaryOp&>(expression);
+
+        GenerateExpression(*unary.operand);
+        vmWriter.WriteArithmetic(unary.op);
+
+    } else {
+        const auto& binary = static_cast<const BinaryOp&>(expression);
+
+        GenerateExpression(*binary.left);
+        GenerateExpression(*binary.right);
+        vmWriter.WriteArithmetic(binary.op);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// VM constants are non-negative, folded negative values are built from one
+void CodeGenerator::GenerateInt(const int value) {
+    if (value >= 0) {
+        vmWriter.WritePush(VMWriter::CONST, value);
+
+    } else if (value == -32768) {
+        // -32768 has no positive counterpart, but is ~32767
+        vmWriter.WritePush(VMWriter::CONST, 32767);
+        vmWriter.WriteArithmetic(VMWriter::NOT);
+
+    } else {
+        vmWriter.WritePush(VMWriter::CONST, -value);
+        vmWriter.WriteArithmetic(VMWriter::NEG);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// pooled literal: statics start out as 0, so build the string only if its
+// slot is still empty
+void CodeGenerator::GenerateString(const StringConstant& constant) {
+    auto slot = stringPool.find(constant.value);
+    if (slot == stringPool.end()) {
+        const int index = poolBase + static_cast<int>(stringPool.size());
+        slot = stringPool.emplace(constant.value, index).first;
+    }
+
+    const std::string readyLabel = stringBase + std::to_string(stringCount);
+    ++stringCount;
+
+    vmWriter.WritePush(VMWriter::STATIC, slot->second);
+    vmWriter.WriteIf(readyLabel);
+
+    GenerateStringBuild(constant.value);
+    vmWriter.WritePop(VMWriter::STATIC, slot->second);
+
+    PlaceLabel(readyLabel);
+    vmWriter.WritePush(VMWriter::STATIC, slot->second);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// leaves a new String object holding targetString on the stack
+void CodeGenerator::GenerateStringBuild(const std::string& targetString) {
+    // NOTE: JackOS only supports upper-case letters
+    const std::string allocator = "String.new";
+    const std::string accumulator = "String.appendChar";
+
+    // first allocate space for full string
+    vmWriter.WritePush(VMWriter::CONST, targetString.size());
+    vmWriter.WriteCall(allocator, 1);
+    thatValid = false;
+
+    // store in "that" pointer
+    vmWriter.WritePop(VMWriter::POINTER, 1);
+
+    // copy string
+    for (unsigned i = 0; i < targetString.size(); ++i) {
+        // set base for String object
+        vmWriter.WritePush(VMWriter::POINTER, 1);
+
+        // push ACII representation of next character
+        int asciiVal = static_cast<int>(std::toupper(targetString[i]));
+        vmWriter.WritePush(VMWriter::CONST, asciiVal);
+
+        // call append method
+        vmWriter.WriteCall(accumulator, 2);
+        vmWriter.WritePop(VMWriter::POINTER, 1);
+    }
+
+    // copy start of string as output
+    vmWriter.WritePush(VMWriter::POINTER, 1);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateKeyword(const KeywordConstant& constant) {
+    if (constant.value == KeywordConstant::NULL_VALUE ||
+        constant.value == KeywordConstant::FALSE_VALUE) {
+        // null and false map to constant 0
+        vmWriter.WritePush(VMWriter::CONST, 0);
+
+    } else if (constant.value == KeywordConstant::TRUE_VALUE) {
+        // true maps to -1 (i.e. all '1's in 2's complement binary)
+        vmWriter.WritePush(VMWriter::CONST, 1);
+        vmWriter.WriteArithmetic(VMWriter::NEG);
+
+    } else {
+        // "this" address pointed to by pointer 0
+        vmWriter.WritePush(VMWriter::POINTER, 0);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateArrayElement(const ArrayElement& element) {
+    int offset = 0;
+    if (ConstantIndex(*element.index, offset)) {
+        LoadThatBase(element.array);
+        vmWriter.WritePush(VMWriter::THAT, offset);
+        return;
+    }
+
+    LoadElementAddress(&element.array, *element.index);
+
+    // push dereferenced value onto the stack
+    vmWriter.WritePush(VMWriter::THAT, 0);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::GenerateCall(const SubroutineCall& call) {
+    if (intrinsics && GenerateIntrinsic(call, true)) {
+        return;
+    }
+
+    int nArgs = static_cast<int>(call.arguments.size());
+
+    if (call.receiver == SubroutineCall::OBJECT_VARIABLE) {
+        // push stored "this" value
+        vmWriter.WritePush(call.object.segment, call.object.index);
+        ++nArgs;
+
+    } else if (call.receiver == SubroutineCall::CURRENT_OBJECT) {
+        // naked subroutine calls are method calls by definition
+        vmWriter.WritePush(VMWriter::POINTER, 0);
+        ++nArgs;
+    }
+
+    for (const auto argument : call.arguments) {
+        if (argument->kind == Expression::STRING_CONST) {
+            GenerateString(static_cast<const StringConstant&>(*argument));
+        } else {
+            GenerateExpression(*argument);
+        }
+    }
+
+    vmWriter.WriteCall(call.name, nArgs);
+    thatValid = false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// expands a call to one of the OS subroutines in intrinsicCalls inline.
+// Returns false, having written nothing, for any other call. The value is
+// only left on the stack if valueUsed.
+bool CodeGenerator::GenerateIntrinsic(const SubroutineCall& call,
+                                      const bool valueUsed) {
+    const auto it = intrinsicCalls.find(call.name);
+    if (it == intrinsicCalls.end()) {
+        return false;
+    }
+
+    const auto intrinsic = it->second;
+    const auto& arguments = call.arguments;
+    const bool hasReceiver = (call.receiver != SubroutineCall::NONE);
+
+    if (intrinsic == PEEK && !hasReceiver && arguments.size() == 1) {
+        LoadElementAddress(nullptr, *arguments[0]);
+        vmWriter.WritePush(VMWriter::THAT, 0);
+
+    } else if (intrinsic == POKE && !hasReceiver && arguments.size() == 2) {
+        GenerateStore(nullptr, *arguments[0], *arguments[1]);
+
+        // void result
+        if (valueUsed) {
+            vmWriter.WritePush(VMWriter::CONST, 0);
+        }
+        return true;
+
+    } else if (intrinsic == ARRAY_NEW && !hasReceiver &&
+               arguments.size() == 1) {
+        GenerateArraySize(*arguments[0]);
+        vmWriter.WriteCall(allocFunction, 1);
+        thatValid = false;
+
+    } else if (intrinsic == ARRAY_DISPOSE && hasReceiver &&
+               arguments.empty()) {
+        if (call.receiver == SubroutineCall::OBJECT_VARIABLE) {
+            vmWriter.WritePush(call.object.segment, call.object.index);
+        } else {
+            vmWriter.WritePush(VMWriter::POINTER, 0);
+        }
+
+        vmWriter.WriteCall(deAllocFunction, 1);
+        thatValid = false;
+
+    } else {
+        return false;
+    }
+
+    if (!valueUsed) {
+        vmWriter.WritePop(VMWriter::TEMP, 0);
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// pushes the size for Array.new, first calling Sys.error as the OS version
+// does if it is not positive; a positive constant needs no check
+void CodeGenerator::GenerateArraySize(const Expression& size) {
+    if (size.kind == Expression::INT_CONST &&
+        static_cast<const IntConstant&>(size).value > 0) {
+        GenerateExpression(size);
+        return;
+    }
+
+    const std::string okLabel = sizeCheckBase + std::to_string(sizeCheckCount);
+    ++sizeCheckCount;
+
+    // held in temp 1 and tested as 0 < size, so the slot is never read
+    // straight after it is written: the peephole optimizer may drop such a
+    // write and leave the value on the stack instead
+    GenerateExpression(size);
+    vmWriter.WritePop(VMWriter::TEMP, 1);
+    vmWriter.WritePush(VMWriter::CONST, 0);
+    vmWriter.WritePush(VMWriter::TEMP, 1);
+    vmWriter.WriteArithmetic(VMWriter::LT);
+    vmWriter.WriteIf(okLabel);
+
+    vmWriter.WritePush(VMWriter::CONST, arraySizeError);
+    vmWriter.WriteCall(errorFunction, 1);
+    vmWriter.WritePop(VMWriter::TEMP, 0);
+
+    PlaceLabel(okLabel);
+    vmWriter.WritePush(VMWriter::TEMP, 1);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// points pointer 1 at the array's base, unless it already holds it
+void CodeGenerator::LoadThatBase(const VarRef& array) {
+    if (thatValid && thatBase.segment == array.segment &&
+        thatBase.index == array.index) {
+        return;
+    }
+
+    vmWriter.WritePush(array.segment, array.index);
+    vmWriter.WritePop(VMWriter::POINTER, 1);
+
+    thatValid = true;
+    thatBase = array;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// points pointer 1 at array[index] for a "that 0" access, or at address
+// index if there is no array
+void CodeGenerator::LoadElementAddress(const VarRef* array,
+                                       const Expression& index) {
+    GenerateExpression(index);
+
+    if (array) {
+        vmWriter.WritePush(array->segment, array->index);
+        vmWriter.WriteArithmetic(VMWriter::ADD);
+    }
+
+    // get address of result into "that" pointer
+    vmWriter.WritePop(VMWriter::POINTER, 1);
+    thatValid = false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// control can arrive at a label from elsewhere, so nothing is known about
+// pointer 1 after it
+void CodeGenerator::PlaceLabel(const std::string& label) {
+    vmWriter.WriteLabel(label);
+    thatValid = false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// sets usesThis and usesThat for anything in statements that needs the
+// object or pointer 1
+void CodeGenerator::FindFrameUse(const StatementList& statements) {
+    for (const auto statement : statements) {
+        if (statement->kind == Statement::LET) {
+            const auto let = static_cast<const LetStatement*>(statement);
+            FindFrameUse(let->target);
+            FindFrameUse(*let->value);
+
+            if (let->index) {
+                usesThat = true;
+                FindFrameUse(*let->index);
+            }
+
+        } else if (statement->kind == Statement::IF) {
+            const auto branch = static_cast<const IfStatement*>(statement);
+            FindFrameUse(*branch->condition);
+            FindFrameUse(branch->thenBody);
+            FindFrameUse(branch->elseBody);
+
+        } else if (statement->kind == Statement::WHILE) {
+            const auto loop = static_cast<const WhileStatement*>(statement);
+            FindFrameUse(*loop->condition);
+            FindFrameUse(loop->body);
+
+        } else if (statement->kind == Statement::DO) {
+            FindFrameUse(*static_cast<const DoStatement*>(statement)->call);
+
+        } else {
+            const auto ret = static_cast<const ReturnStatement*>(statement);
+            if (ret->value) FindFrameUse(*ret->value);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CodeGenerator::FindFrameUse(const Expression& expression) {
+    if (expression.kind == Expression::STRING_CONST) {
+        // built through pointer 1
+        usesThat = true;
+
+    } else if (expression.kind == Expression::KEYWORD_CONST) {
+        const auto& keyword = static_cast<const KeywordConstant&>(expression);
+        if (keyword.value == KeywordConstant::THIS_VALUE) usesThis = true;
+
+    } else if (expression.kind == Expression::VARIABLE) {
+        FindFrameUse(static_cast<const Variable&>(expression).var);
+
+    } else if (expression.kind == Expression::ARRAY_ELEMENT) {
+        const auto& element = static_cast<const ArrayElement&>(expression);
+        usesThat = true;
+        FindFrameUse(element.array);
+        FindFrameUse(*element.index);
+
+    } else if (expression.kind == Expression::CALL) {
+        const auto& call = static_cast<const SubroutineCall&>(expression);
+
+        if (call.receiver == SubroutineCall::CURRENT_OBJECT) {
+            usesThis = true;
+        } else if (call.receiver == SubroutineCall::OBJECT_VARIABLE) {
+            FindFrameUse(call.object);
+        }
+
+        // Memory.peek and Memory.poke may be expanded through pointer 1
+        const auto intrinsic = intrinsicCalls.find(call.name);
+        if (intrinsics && intrinsic != intrinsicCalls.end() &&
+            (intrinsic->second == PEEK || intrinsic->second == POKE)) {
+            usesThat = true;
+        }
+
+        for (const auto argument : call.arguments) {
+            FindFrameUse(*argument);
+        }
+
+    } else if (expression.kind == Expression::UNARY) {
+        FindFrameUse(*static_cast<const UnaryOp&>(expression).operand);
+
+    } else if (expression.kind == Expression::BINARY) {
+        const auto& binary = static_cast<const BinaryOp&>(expression);
+        FindFrameUse(*binary.left);
+        FindFrameUse(*binary.right);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// fields live in the object pointer 0 points at
+void CodeGenerator::FindFrameUse(const VarRef& var) {
+    if (var.segment == VMWriter::THIS) usesThis = true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool CodeGenerator::ConstantIndex(const Expression& index, int& offset) {
+    if (index.kind != Expression::INT_CONST) {
+        return false;
+    }
+
+    offset = static_cast<const IntConstant&>(index).value;
+    return offset >= 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// true if the expression or any part of it is one of the kinds in the mask
+bool CodeGenerator::ContainsKind(const Expression& expression,
+                                 const unsigned kinds) {
+    if (kinds & KindBit(expression.kind)) {
+        return true;
+    }
+
+    if (expression.kind == Expression::ARRAY_ELEMENT) {
+        const auto& element = static_cast<const ArrayElement&>(expression);
+        return ContainsKind(*element.index, kinds);
+
+    } else if (expression.kind == Expression::CALL) {
+        const auto& call = static_cast<const SubroutineCall&>(expression);
+        for (const auto argument : call.arguments) {
+            if (ContainsKind(*argument, kinds)) return true;
+        }
+
+    } else if (expression.kind == Expression::UNARY) {
+        const auto& unary = static_cast<const UnaryOp&>(expression);
+        return ContainsKind(*unary.operand, kinds);
+
+    } else if (expression.kind == Expression::BINARY) {
+        const auto& binary = static_cast<const BinaryOp&>(expression);
+        return ContainsKind(*binary.left, kinds) ||
+               ContainsKind(*binary.right, kinds);
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// true if the expression can only evaluate to true (-1) or false (0)
+bool CodeGenerator::IsBoolean(const Expression& expression) {
+    if (expression.kind == Expression::KEYWORD_CONST) {
+        const auto& keyword = static_cast<const KeywordConstant&>(expression);
+        return keyword.value != KeywordConstant::THIS_VALUE;
+
+    } else if (expression.kind == Expression::INT_CONST) {
+        const auto value = static_cast<const IntConstant&>(expression).value;
+        return value == 0 || value == -1;
+
+    } else if (expression.kind == Expression::UNARY) {
+        const auto& unary = static_cast<const UnaryOp&>(expression);
+        return unary.op == VMWriter::NOT && IsBoolean(*unary.operand);
+
+    } else if (expression.kind == Expression::BINARY) {
+        const auto& binary = static_cast<const BinaryOp&>(expression);
+        const auto op = binary.op;
+
+        if (IsComparison(expression)) {
+            return true;
+        }
+
+        return (op == VMWriter::AND || op == VMWriter::OR) &&
+               IsBoolean(*binary.left) && IsBoolean(*binary.right);
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool CodeGenerator::IsComparison(const Expression& expression) {
+    if (expression.kind != Expression::BINARY) {
+        return false;
+    }
+
+    const auto op = static_cast<const BinaryOp&>(expression).op;
+    return op == VMWriter::LT || op == VMWriter::GT || op == VMWriter::EQ;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// for a constant that IsBoolean accepts
+bool CodeGenerator::IsTrue(const Expression& constant) {
+    if (constant.kind == Expression::INT_CONST) {
+        return static_cast<const IntConstant&>(constant).value == -1;
+    }
+
+    const auto& keyword = static_cast<const KeywordConstant&>(constant);
+    return keyword.value == KeywordConstant::TRUE_VALUE;
+}
+
+/* -------------------------------------------------------------------------- */
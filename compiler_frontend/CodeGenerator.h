@@ -0,0 +1,135 @@
+#ifndef CODE_GENERATOR_H
+#define CODE_GENERATOR_H
+
+#include "Ast.h"
+#include "VMWriter.h"
+
+#include <map>
+#include <string>
+
+// Walks the syntax tree of one class and writes its VM code. Label numbers
+// are handed out in source order, per class.
+//
+// A string literal passed directly as a call argument, as in
+// Output.printString("..."), is built once, the first time it is evaluated,
+// and kept in a static placed after the class's own statics; every call made
+// with the same literal gets the same String object. A callee that disposes,
+// modifies or keeps its argument must therefore not be handed a literal.
+// Literals anywhere else (assigned, stored, returned or part of a larger
+// expression) are built anew each time, so code that owns its strings, e.g.
+// "let s = ...; do s.dispose();", is unaffected.
+//
+// Array elements at constant indices are read and written as "that k". While
+// pointer 1 holds an array's base, later constant-index accesses to the same
+// array reuse it; labels, calls and writes to the variable end the reuse.
+//
+// Calls to the OS subroutines in intrinsicCalls are expanded inline unless
+// intrinsics are turned off, e.g. for an OS whose versions behave
+// differently: Memory.peek and Memory.poke become a "that 0" access, and the
+// Array constructor and destructor call the Memory functions they wrap. The
+// constructor keeps the OS's check that the size is positive, which is left
+// out only for a constant size that passes it.
+//
+// A subroutine that never needs to set pointer 0 or pointer 1 is announced
+// with "preserves", so that its return can skip restoring them. Methods that
+// do not touch their object skip loading pointer 0 as well.
+class CodeGenerator {
+  public:
+    CodeGenerator(VMWriter& writer);
+
+    // remove unwanted constructors
+    CodeGenerator(const CodeGenerator& that) = delete;
+    CodeGenerator(const CodeGenerator&& that) = delete;
+    CodeGenerator& operator=(const CodeGenerator& that) = delete;
+    CodeGenerator& operator=(const CodeGenerator&& that) = delete;
+
+    void GenerateClass(const ClassDec& classDec);
+    void SetIntrinsics(const bool enable) { intrinsics = enable; }
+
+    // data
+  private:
+    VMWriter& vmWriter;
+    unsigned loopCount;
+    unsigned branchCount;
+    unsigned skipCount;
+    unsigned stringCount;
+    unsigned sizeCheckCount;
+    int poolBase;
+    std::map<std::string, int> stringPool;
+    bool intrinsics;
+
+    // array variable whose value pointer 1 currently holds, if thatValid
+    bool thatValid;
+    VarRef thatBase;
+
+    // whether the subroutine being generated reads its object or writes
+    // pointer 1, found before any of its code is written
+    bool usesThis;
+    bool usesThat;
+
+    const std::string loopBase = "WHILE_LOOP";
+    const std::string branchBase = "IF_STATEMENT";
+    const std::string endPrefix = "END_";
+    const std::string testPrefix = "TEST_";
+    const std::string skipBase = "COND_SKIP";
+    const std::string stringBase = "STRING_READY";
+    const std::string sizeCheckBase = "ARRAY_SIZE_OK";
+
+    const std::string allocFunction = "Memory.alloc";
+    const std::string deAllocFunction = "Memory.deAlloc";
+    const std::string errorFunction = "Sys.error";
+
+    // Sys.error code for a non-positive Array.new size
+    static constexpr int arraySizeError = 2;
+
+    enum Intrinsic { PEEK, POKE, ARRAY_NEW, ARRAY_DISPOSE };
+
+    const std::map<std::string, Intrinsic> intrinsicCalls = {
+        {"Memory.peek", PEEK},
+        {"Memory.poke", POKE},
+        {"Array.new", ARRAY_NEW},
+        {"Array.dispose", ARRAY_DISPOSE}};
+
+    // methods
+  private:
+    void GenerateSubroutine(const SubroutineDec& subroutine);
+
+    void GenerateStatements(const StatementList& statements);
+    void GenerateLet(const LetStatement& statement);
+    void GenerateStore(const VarRef* array, const Expression& index,
+                       const Expression& value);
+    void GenerateIf(const IfStatement& statement);
+    void GenerateWhile(const WhileStatement& statement);
+    void GenerateBranch(const Expression& condition, const std::string& label,
+                        const bool jumpIfTrue);
+    void GenerateDo(const DoStatement& statement);
+    void GenerateReturn(const ReturnStatement& statement);
+
+    void GenerateExpression(const Expression& expression);
+    void GenerateInt(const int value);
+    void GenerateString(const StringConstant& constant);
+    void GenerateStringBuild(const std::string& targetString);
+    void GenerateKeyword(const KeywordConstant& constant);
+    void GenerateArrayElement(const ArrayElement& element);
+    void GenerateCall(const SubroutineCall& call);
+    bool GenerateIntrinsic(const SubroutineCall& call, const bool valueUsed);
+    void GenerateArraySize(const Expression& size);
+
+    void LoadThatBase(const VarRef& array);
+    void LoadElementAddress(const VarRef* array, const Expression& index);
+    void PlaceLabel(const std::string& label);
+
+    void FindFrameUse(const StatementList& statements);
+    void FindFrameUse(const Expression& expression);
+    void FindFrameUse(const VarRef& var);
+
+    static bool IsBoolean(const Expression& expression);
+    static bool IsComparison(const Expression& expression);
+    static bool IsTrue(const Expression& constant);
+    static bool ConstantIndex(const Expression& index, int& offset);
+    static bool ContainsKind(const Expression& expression,
+                             const unsigned kinds);
+    static unsigned KindBit(const Expression::Kind kind) { return 1u << kind; }
+};
+
+#endif /* CODE_GENERATOR_H */
@@ -1,30 +1,60 @@
 #include "CompilationEngine.h"
+#include "CodeGenerator.h"
+#include "ConstantFolder.h"
+#include "ExpressionScheduler.h"
 
-#include <cctype>
 #include <cstdlib>
-#include <iostream>
 
 /* -------------------------------------------------------------------------- */
 
 CompilationEngine::CompilationEngine(const std::string& infileName,
-                                     const std::string& outfileName) :
+                                     const std::string& outfileName,
+                                     const SignatureTable& programSignatures,
+                                     const VMWriter::Format format) :
         currInputFile(infileName),
         currClass(),
-        outFile(outfileName),
-        loopCount(0),
-        branchCount(0),
+        currSubroutineKind(SubroutineDec::FUNCTION),
+        outFile(outfileName, format == VMWriter::BINARY
+                                 ? std::ios::out | std::ios::binary
+                                 : std::ios::out),
         jtok(infileName),
         compilerErrorHandler(),
         symTable(),
-        vmWriter(outFile) {
+        signatures(programSignatures),
+        arena(),
+        vmWriter(outFile, format),
+        intrinsics(true),
+        referencedClasses() {
     if (!outFile.is_open()) {
-        std::cerr << "ERROR: Could not open file \"" << outfileName << "\"\n";
-        std::exit(EXIT_FAILURE);
+        throw CompileError(
+            "ERROR: Could not open file \"" + outfileName + "\"",
+            EXIT_FAILURE);
     }
 }
 
 /* -------------------------------------------------------------------------- */
 
+// no output file, commands go straight to sink
+CompilationEngine::CompilationEngine(const std::string& infileName,
+                                     VMSink& sink,
+                                     const SignatureTable& programSignatures) :
+        currInputFile(infileName),
+        currClass(),
+        currSubroutineKind(SubroutineDec::FUNCTION),
+        outFile(),
+        jtok(infileName),
+        compilerErrorHandler(),
+        symTable(),
+        signatures(programSignatures),
+        arena(),
+        vmWriter(outFile),
+        intrinsics(true),
+        referencedClasses() {
+    vmWriter.SetSink(&sink);
+}
+
+/* -------------------------------------------------------------------------- */
+
 void CompilationEngine::CompileClass() {
     // syntax: 'class' className '{' classVarDec* subroutineDec* '}'
 
@@ -50,6 +80,7 @@ void CompilationEngine::CompileClass() {
 
     // class name must prefix all function declarations
     currClass = jtok.GetToken();
+    ClassDec* classDec = arena.Make<ClassDec>(currClass);
 
     // PrintIdentifier(CLASS, DEFINED);
     jtok.Advance();
@@ -59,13 +90,13 @@ void CompilationEngine::CompileClass() {
 
     // check for classVarDec vs. subroutineDec and repeat
     while (jtok.TokenType() != JackTokenizer::SYMBOL) {
-        const std::string token = jtok.GetToken();
+        const auto token = jtok.GetToken();
 
         if (token == "static" || token == "field") {
             CompileClassVarDec();
         } else if (token == "constructor" || token == "function" ||
                    token == "method") {
-            CompileSubroutine();
+            classDec->subroutines.push_back(ParseSubroutine());
         } else {
             const std::string errMsg =
                 "Unrecognized statement in class declaration";
@@ -76,6 +107,21 @@ void CompilationEngine::CompileClass() {
     // '}' literal
     // no advancing since previous loop caught us up to here
     CheckLiteralSymbol("}", "class declaration");
+
+    // the whole class is parsed before any code is written
+    classDec->nStatics = symTable.VarCount(SymbolTable::STATIC);
+
+    ConstantFolder folder(arena);
+    folder.FoldClass(*classDec);
+
+    ExpressionScheduler scheduler;
+    scheduler.ScheduleClass(*classDec);
+
+    CodeGenerator generator(vmWriter);
+    generator.SetIntrinsics(intrinsics);
+    generator.GenerateClass(*classDec);
+
+    vmWriter.Close();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -153,7 +199,8 @@ void CompilationEngine::PrintLiteralSymbol(const std::string& symbol,
         compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
     }
 
-    PrintToken(tokenString.at(jtok.TokenType()), jtok.GetToken());
+    PrintToken(tokenString.at(jtok.TokenType()),
+               std::string(jtok.GetToken()));
     jtok.Advance();
 }
 
@@ -182,7 +229,7 @@ void CompilationEngine::PrintIdentifier(const Category category,
         outFile << "\"true\" ";
         outFile << "index=";
 
-        outFile << "\"" << symTable.IndexOf(jtok.GetToken()) << "\"";
+        outFile << "\"" << symTable.Find(jtok.GetToken())->index << "\"";
     } else {
         outFile << "\"false\"";
     }
@@ -220,18 +267,18 @@ void CompilationEngine::CompileClassVarDec() {
 void CompilationEngine::CompileVarDecCommon(const std::string& terminal,
                                             const Category category) {
     // store variable info
-    SymbolTable::VarData data;
+    SymbolTable::VARKIND kind = SymbolTable::VAR;
     if (category == VAR) {
-        data.kind = SymbolTable::VAR;
+        kind = SymbolTable::VAR;
 
     } else if (category == ARGUMENT) {
-        data.kind = SymbolTable::ARG;
+        kind = SymbolTable::ARG;
 
     } else if (category == STATIC) {
-        data.kind = SymbolTable::STATIC;
+        kind = SymbolTable::STATIC;
 
     } else if (category == FIELD) {
-        data.kind = SymbolTable::FIELD;
+        kind = SymbolTable::FIELD;
 
     } else {
         const std::string errMsg =
@@ -246,7 +293,7 @@ void CompilationEngine::CompileVarDecCommon(const std::string& terminal,
         compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
     }
 
-    data.type = jtok.GetToken();
+    const std::string type(jtok.GetToken());
 
     // PrintToken(tokenString.at(jtok.TokenType()), jtok.GetToken());
     jtok.Advance();
@@ -258,7 +305,7 @@ void CompilationEngine::CompileVarDecCommon(const std::string& terminal,
     }
 
     // add to symbol table
-    symTable.Define(jtok.GetToken(), data.type, data.kind);
+    symTable.Define(jtok.GetToken(), type, kind);
 
     // print
     // PrintIdentifier(category, DEFINED);
@@ -275,7 +322,7 @@ void CompilationEngine::CompileVarDecCommon(const std::string& terminal,
         }
 
         if (jtok.TokenType() == JackTokenizer::IDENTIFIER) {
-            symTable.Define(jtok.GetToken(), data.type, data.kind);
+            symTable.Define(jtok.GetToken(), type, kind);
             // PrintIdentifier(category, DEFINED);
         } else {
             // PrintToken(tokenString.at(jtok.TokenType()), jtok.GetToken());
@@ -287,19 +334,19 @@ void CompilationEngine::CompileVarDecCommon(const std::string& terminal,
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileSubroutine() {
+SubroutineDec* CompilationEngine::ParseSubroutine() {
     // syntax: ('constructor' | 'function' | 'method') ('void' | type)
     //         subroutineName '(' parameterList ')' subroutineBody
 
-    // clear symbol table
-    symTable.StartSubroutine();
-
     // advance over function type (already checked in caller)
-    const auto funcType = jtok.GetToken();
+    const std::string funcType(jtok.GetToken());
+
+    // clear symbol table, method arguments are offset by the hidden "this"
+    symTable.StartSubroutine(funcType == "method");
     jtok.Advance();
 
     // ('void' | type)
-    std::set<std::string> functionTypes(validTypes);
+    TokenSet functionTypes(validTypes);
     functionTypes.insert("void");
 
     if (functionTypes.find(jtok.GetToken()) == functionTypes.end() &&
@@ -318,9 +365,13 @@ void CompilationEngine::CompileSubroutine() {
         compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
     }
 
-    const auto funcName = jtok.GetToken();
+    const std::string funcName(jtok.GetToken());
     jtok.Advance();
 
+    currSubroutineKind = subroutineKinds.at(funcType);
+    SubroutineDec* subroutine = arena.Make<SubroutineDec>(
+        currSubroutineKind, currClass + "." + funcName, isVoid);
+
     // literal '('
     CheckLiteralSymbol("(", "subroutine parameter list");
 
@@ -333,13 +384,9 @@ void CompilationEngine::CompileSubroutine() {
     CheckLiteralSymbol(")", "subroutine parameter list");
 
     // subroutineBody
-    CompileSubroutineBody(funcName, funcType);
-
-    if (isVoid) {
-        vmWriter.WritePush(VMWriter::CONST, 0);
-    }
+    ParseSubroutineBody(subroutine);
 
-    vmWriter.WriteReturn();
+    return subroutine;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -352,8 +399,7 @@ void CompilationEngine::CompileParameterList() {
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileSubroutineBody(const std::string& funcName,
-                                              const std::string& funcType) {
+void CompilationEngine::ParseSubroutineBody(SubroutineDec* subroutine) {
     // syntax: '{' varDec* statements '}'
 
     // literal '{'
@@ -366,35 +412,12 @@ void CompilationEngine::CompileSubroutineBody(const std::string& funcName,
         CompileVarDec();
     }
 
-    auto nLocal = symTable.VarCount(SymbolTable::VAR);
-    auto vmName = currClass + "." + funcName;
-
-    if (funcType == "method") {
-        // make sure we track arg variables with 1-offset
-        symTable.SetMethod();
-    }
-
-    vmWriter.WriteFunction(vmName, nLocal);
-
-    if (funcType == "method") {
-        // need to align "this" segment with hidden arg
-        vmWriter.WritePush(VMWriter::ARG, 0);
-        vmWriter.WritePop(VMWriter::POINTER, 0);
-
-    } else if (funcType == "constructor") {
-        // need to allocate space for the object and store in "this" pointer
-        const auto size = symTable.VarCount(SymbolTable::FIELD);
-        const std::string allocFunction = "Memory.alloc";
-
-        vmWriter.WritePush(VMWriter::CONST, size);
-        vmWriter.WriteCall(allocFunction, 1);
-
-        vmWriter.WritePop(VMWriter::POINTER, 0);
-    }
+    subroutine->nLocals = symTable.VarCount(SymbolTable::VAR);
+    subroutine->nFields = symTable.VarCount(SymbolTable::FIELD);
 
     // statements
     while (jtok.GetToken() != "}") {
-        CompileStatements();
+        ParseStatements(subroutine->body);
     }
 
     // literal '}'
@@ -427,21 +450,21 @@ void CompilationEngine::CompileVarDec() {
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileStatements() {
+void CompilationEngine::ParseStatements(StatementList& statements) {
     // syntax: statement* where statement is prefixed by one of
     // 'let', 'if', 'while', 'do', 'return'
     while (jtok.TokenType() == JackTokenizer::KEYWORD) {
-        const std::string token = jtok.GetToken();
+        const auto token = jtok.GetToken();
         if (token == "let") {
-            CompileLet();
+            statements.push_back(ParseLet());
         } else if (token == "if") {
-            CompileIf();
+            statements.push_back(ParseIf());
         } else if (token == "while") {
-            CompileWhile();
+            statements.push_back(ParseWhile());
         } else if (token == "do") {
-            CompileDo();
+            statements.push_back(ParseDo());
         } else if (token == "return") {
-            CompileReturn();
+            statements.push_back(ParseReturn());
             break;
         } else {
             const std::string errMsg = "Unexpected token in statement";
@@ -452,7 +475,7 @@ void CompilationEngine::CompileStatements() {
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileDo() {
+Statement* CompilationEngine::ParseDo() {
     // syntax: 'do' subroutineCall ';'
 
     // advance over 'do' -> checked by caller
@@ -464,18 +487,17 @@ void CompilationEngine::CompileDo() {
         compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
     }
 
-    CompileSubroutineCall();
+    SubroutineCall* call = ParseSubroutineCall();
 
     // literal ';'
     CheckLiteralSymbol(";", "subroutine call");
 
-    // function is assumed void, so pop its value and ignore
-    vmWriter.WritePop(VMWriter::TEMP, 0);
+    return arena.Make<DoStatement>(call);
 }
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileLet() {
+Statement* CompilationEngine::ParseLet() {
     // syntax: 'let' varName ('[' expression ']')? '=' expression ';'
 
     // 'let' -> checked by caller
@@ -488,33 +510,19 @@ void CompilationEngine::CompileLet() {
         compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
     }
 
-    const std::string varName = jtok.GetToken();
-    if (!symTable.Check(varName)) {
-        const std::string errMsg =
-            "Variable " + varName + " not defined in current scope";
-        compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
-    }
+    const VarRef target = LookupVar();
 
     jtok.Advance();
 
-    bool isArray = false;
+    Expression* index = nullptr;
 
     // optional brackets
     if (jtok.GetToken() == "[") {
-        isArray = true;
-
         // literal '['
         CheckLiteralSymbol("[", "array dereference");
 
         // expression
-        CompileExpression();
-
-        // find memory location to store result
-        // vmWriter.WritePush(seg, index);
-        // vmWriter.WriteArithmetic(VMWriter::ADD);
-
-        // pointer 1 is "that" segment
-        // vmWriter.WritePop(VMWriter::TEMP, 1);
+        index = ParseExpression();
 
         // literal ']'
         CheckLiteralSymbol("]", "array dereference");
@@ -524,64 +532,27 @@ void CompilationEngine::CompileLet() {
     CheckLiteralSymbol("=", "let statement");
 
     // expression
-    CompileExpression();
-
-    // pop result to selected variable
-
-    auto kind = symTable.KindOf(varName);
-    auto index = symTable.IndexOf(varName);
-    VMWriter::Segment seg = kindToSegment.at(kind);
-
-    if (isArray) {
-        // hold return value
-        vmWriter.WritePop(VMWriter::TEMP, 1);
-
-        // current stack element is bracket expression, so add var val
-        vmWriter.WritePush(seg, index);
-        vmWriter.WriteArithmetic(VMWriter::ADD);
-
-        // move to "that" pointer
-        vmWriter.WritePop(VMWriter::POINTER, 1);
-
-        // get value from temp
-        vmWriter.WritePush(VMWriter::TEMP, 1);
-        vmWriter.WritePop(VMWriter::THAT, 0);
-
-    } else {
-        vmWriter.WritePop(seg, index);
-    }
+    Expression* value = ParseExpression();
 
     // literal ';'
     CheckLiteralSymbol(";", "let statement");
+
+    return arena.Make<LetStatement>(target, index, value);
 }
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileWhile() {
+Statement* CompilationEngine::ParseWhile() {
     // syntax: 'while' '(' expression ')' '{' statements '}'
 
-    const auto myLoopCount = loopCount;
-    ++loopCount;
-
     // 'while' -> checked by caller
     jtok.Advance();
 
     // literal '('
     CheckLiteralSymbol("(", "while statement condition");
 
-    // label loop beginning
-    const std::string loopID = loopBase + std::to_string(myLoopCount);
-    vmWriter.WriteLabel(loopID);
-
     // expression
-    CompileExpression();
-
-    // check negated expression
-    vmWriter.WriteArithmetic(VMWriter::NOT);
-
-    // jump to end if condition fails
-    const std::string endLabel = endPrefix + loopID;
-    vmWriter.WriteIf(endLabel);
+    WhileStatement* loop = arena.Make<WhileStatement>(ParseExpression());
 
     // literal ')'
     CheckLiteralSymbol(")", "while statement condition");
@@ -591,47 +562,42 @@ void CompilationEngine::CompileWhile() {
 
     // statements
     while (jtok.GetToken() != "}") {
-        CompileStatements();
+        ParseStatements(loop->body);
     }
 
-    // jump to top of loop
-    vmWriter.WriteGoto(loopID);
-
-    // label loop end
-    vmWriter.WriteLabel(endLabel);
-
     // literal '}'
     CheckLiteralSymbol("}", "while statement body");
+
+    return loop;
 }
 
 /* -------------------------------------------------------------------------- */
 
-// NOTE: actual VM return command is appended at the end of the calling
-//       function, so this compilation only checks for an expression
-void CompilationEngine::CompileReturn() {
+Statement* CompilationEngine::ParseReturn() {
     // syntax: 'return' expression? ';'
 
     // advance over 'return' -> checked by caller
     jtok.Advance();
 
+    Expression* value = nullptr;
+
     // check for expression
     if (jtok.GetToken() != ";") {
-        CompileExpression();
+        value = ParseExpression();
     }
 
     // literal ';'
     CheckLiteralSymbol(";", "return statement");
+
+    return arena.Make<ReturnStatement>(value);
 }
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileIf() {
+Statement* CompilationEngine::ParseIf() {
     // syntax: 'if' '(' expression ')' '{' statements '}' ('else' '{' statements
     // '}')?
 
-    const auto myBranchCount = branchCount;
-    ++branchCount;
-
     // 'if' -> checked by caller
     jtok.Advance();
 
@@ -639,15 +605,7 @@ void CompilationEngine::CompileIf() {
     CheckLiteralSymbol("(", "if condition");
 
     // expression
-    CompileExpression();
-
-    // check negated expression
-    vmWriter.WriteArithmetic(VMWriter::NOT);
-
-    // jump to end of if branch if condition fails
-    const std::string midLabel =
-        "MID_" + branchBase + std::to_string(myBranchCount);
-    vmWriter.WriteIf(midLabel);
+    IfStatement* branch = arena.Make<IfStatement>(ParseExpression());
 
     // literal ')'
     CheckLiteralSymbol(")", "if condition");
@@ -656,19 +614,11 @@ void CompilationEngine::CompileIf() {
     CheckLiteralSymbol("{", "if condition body");
 
     // expression
-    CompileStatements();
+    ParseStatements(branch->thenBody);
 
     // literal '}'
     CheckLiteralSymbol("}", "if condition body");
 
-    // jump to end of all blocks (including else)
-    const std::string endLabel =
-        endPrefix + branchBase + std::to_string(myBranchCount);
-    vmWriter.WriteGoto(endLabel);
-
-    // write label for end of if branch
-    vmWriter.WriteLabel(midLabel);
-
     // optional else clause
     if (jtok.GetToken() == "else") {
         // 'else'
@@ -678,43 +628,38 @@ void CompilationEngine::CompileIf() {
         CheckLiteralSymbol("{", "if condition body");
 
         // expression
-        CompileStatements();
+        ParseStatements(branch->elseBody);
 
         // literal '}'
         CheckLiteralSymbol("}", "if condition body");
     }
 
-    // label end of all blocks
-    vmWriter.WriteLabel(endLabel);
+    return branch;
 }
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileSubroutineCall() {
+SubroutineCall* CompilationEngine::ParseSubroutineCall() {
     // syntax: subroutineName '(' expressionList ')' |
     //         (className | varName) '.' subroutineName '(' expressionList ')'
 
+    SubroutineCall* call = arena.Make<SubroutineCall>();
+    const unsigned callLine = jtok.LineNum();
+
     // subroutineName | (className | varName) -> identifier checked by caller
     std::string className = currClass;
     std::string funcName = "dummy";
-    bool isMethod = false;
-    if (jtok.LookaheadToken() == "(") {
+    if (jtok.Peek(1) == "(") {
         // regular subroutine
         funcName = jtok.GetToken();
     } else {
         // class or variable (class won't be in lookup table)
-        const std::string varName = jtok.GetToken();
-        if (symTable.Check(varName)) {
+        const auto object = symTable.Find(jtok.GetToken());
+        if (object) {
             // method, need to push "this" segment stored in variable
-            className = symTable.TypeOf(varName);
-            isMethod = true;
-
-            auto kind = symTable.KindOf(varName);
-            auto index = symTable.IndexOf(varName);
-            VMWriter::Segment seg = kindToSegment.at(kind);
-
-            // push stored "this" value
-            vmWriter.WritePush(seg, index);
+            className = object->type;
+            call->receiver = SubroutineCall::OBJECT_VARIABLE;
+            call->object = {object->segment, object->index};
 
         } else {
             className = jtok.GetToken();
@@ -727,26 +672,18 @@ void CompilationEngine::CompileSubroutineCall() {
         // literal '('
         CheckLiteralSymbol("(", "subroutine call");
 
-        int expressionCount = 0;
-
-        // naked subroutine calls are method calls by definition, so push "this"
-        vmWriter.WritePush(VMWriter::POINTER, 0);
+        // naked subroutine calls are assumed to be method calls until the
+        // target's signature says otherwise
+        call->receiver = SubroutineCall::CURRENT_OBJECT;
 
         // expressionList
         if (jtok.GetToken() != ")") {
-            expressionCount = CompileExpressionList();
+            ParseExpressionList(call->arguments);
         }
 
-        // factor in "this" pointer
-        ++expressionCount;
-
         // literal ')'
         CheckLiteralSymbol(")", "subroutine call");
 
-        const auto fname = className + "." + funcName;
-
-        vmWriter.WriteCall(fname, expressionCount);
-
     } else if (jtok.GetToken() == ".") {
         // literal '.'
         CheckLiteralSymbol(".", "subroutine call");
@@ -763,49 +700,109 @@ void CompilationEngine::CompileSubroutineCall() {
         // literal '('
         CheckLiteralSymbol("(", "subroutine call");
 
-        int expressionCount = 0;
         // expressionList
         if (jtok.GetToken() != ")") {
-            expressionCount = CompileExpressionList();
+            ParseExpressionList(call->arguments);
         }
 
         // literal ')'
         CheckLiteralSymbol(")", "subroutine call");
 
-        const auto fname = className + "." + funcName;
-        if (isMethod) ++expressionCount;
-
-        vmWriter.WriteCall(fname, expressionCount);
-
     } else {
         const std::string errMsg = "Unexpected symbol in subroutine call";
         compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
     }
+
+    call->name = className + "." + funcName;
+    ResolveCall(call, className, funcName, callLine);
+
+    return call;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// checks a parsed call against the signature of its target and settles
+// whether "this" is passed to an unqualified call
+void CompilationEngine::ResolveCall(SubroutineCall* call,
+                                    const std::string& className,
+                                    const std::string& funcName,
+                                    const unsigned line) {
+    // an unknown class is recorded too, adding it later changes this check
+    referencedClasses.insert(className);
+
+    const auto signature = signatures.Find(className, funcName);
+
+    if (!signature) {
+        if (signatures.HasClass(className)) {
+            const std::string errMsg =
+                "Subroutine " + call->name + " is not declared";
+            compilerErrorHandler.Report(currInputFile, line, errMsg);
+        }
+
+        // class outside the compilation set, take the call as written
+        return;
+    }
+
+    const bool isMethod = (signature->kind == SubroutineDec::METHOD);
+
+    if (call->receiver == SubroutineCall::CURRENT_OBJECT) {
+        if (!isMethod) {
+            call->receiver = SubroutineCall::NONE;
+
+        } else if (currSubroutineKind == SubroutineDec::FUNCTION) {
+            const std::string errMsg =
+                "Method " + call->name + " called from a function";
+            compilerErrorHandler.Report(currInputFile, line, errMsg);
+        }
+
+    } else if (call->receiver == SubroutineCall::OBJECT_VARIABLE) {
+        if (!isMethod) {
+            const std::string errMsg =
+                "Subroutine " + call->name + " is not a method";
+            compilerErrorHandler.Report(currInputFile, line, errMsg);
+        }
+
+    } else if (isMethod) {
+        const std::string errMsg =
+            "Method " + call->name + " called without an object";
+        compilerErrorHandler.Report(currInputFile, line, errMsg);
+    }
+
+    const auto nArgs = static_cast<int>(call->arguments.size());
+    if (nArgs != signature->nArgs) {
+        const std::string errMsg =
+            "Subroutine " + call->name + " expects " +
+            std::to_string(signature->nArgs) + " argument(s) but was given " +
+            std::to_string(nArgs);
+        compilerErrorHandler.Report(currInputFile, line, errMsg);
+    }
 }
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileExpression() {
+Expression* CompilationEngine::ParseExpression() {
     // syntax: term (op term)*
 
+    Expression* result = nullptr;
+
     // term
     auto tokenType = jtok.TokenType();
     if (tokenType == JackTokenizer::INT_CONST ||
         tokenType == JackTokenizer::STRING_CONST ||
         tokenType == JackTokenizer::KEYWORD) {
-        CompileTerm();
+        result = ParseTerm();
     } else if (tokenType == JackTokenizer::IDENTIFIER) {
-        CompileTerm();
+        result = ParseTerm();
     } else if (jtok.GetToken() == "(") {
-        CompileTerm();
+        result = ParseTerm();
     } else if (unaryOpTypes.find(jtok.GetToken()) != unaryOpTypes.end()) {
-        CompileTerm();
+        result = ParseTerm();
     } else {
         const std::string errMsg = "Unrecognized token in expression";
         compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
     }
 
-    // optional operators and terms
+    // optional operators and terms, grouped from the left
     std::string currOp = "";
     while (expressionTerminals.find(jtok.GetToken()) ==
            expressionTerminals.end()) {
@@ -816,10 +813,11 @@ void CompilationEngine::CompileExpression() {
             jtok.Advance();
         } else {
             // term
-            CompileTerm();
+            Expression* term = ParseTerm();
 
             if (binaryOpCommands.find(currOp) != binaryOpCommands.end()) {
-                vmWriter.WriteArithmetic(binaryOpCommands.at(currOp));
+                result = arena.Make<BinaryOp>(binaryOpCommands.at(currOp),
+                                              result, term);
 
             } else {
                 const std::string errMsg =
@@ -829,52 +827,28 @@ void CompilationEngine::CompileExpression() {
             }
         }
     }
+
+    return result;
 }
 
 /* -------------------------------------------------------------------------- */
 
-void CompilationEngine::CompileTerm() {
+Expression* CompilationEngine::ParseTerm() {
     // syntax: integerConstant | stringConstant | keywordConstant |
     //         varName | varName '[' expression ']' | subroutineCall |
     //         '(' expression ')' | unaryOp term
 
+    Expression* term = nullptr;
+
     auto tokenType = jtok.TokenType();
     if (tokenType == JackTokenizer::INT_CONST) {
         // integerConstant
-        vmWriter.WritePush(VMWriter::CONST, std::stoi(jtok.GetToken()));
+        term = arena.Make<IntConstant>(jtok.IntVal());
         jtok.Advance();
 
     } else if (tokenType == JackTokenizer::STRING_CONST) {
         // stringConstant
-        // NOTE: JackOS only supports upper-case letters
-        const std::string targetString = jtok.GetToken();
-        const std::string allocator = "String.new";
-        const std::string accumulator = "String.appendChar";
-
-        // first allocate space for full string
-        vmWriter.WritePush(VMWriter::CONST, targetString.size());
-        vmWriter.WriteCall(allocator, 1);
-
-        // store in "that" pointer
-        vmWriter.WritePop(VMWriter::POINTER, 1);
-
-        // copy string
-        for (unsigned i = 0; i < targetString.size(); ++i) {
-            // set base for String object
-            vmWriter.WritePush(VMWriter::POINTER, 1);
-
-            // push ACII representation of next character
-            int asciiVal = static_cast<int>(std::toupper(targetString[i]));
-            vmWriter.WritePush(VMWriter::CONST, asciiVal);
-
-            // call append method
-            vmWriter.WriteCall(accumulator, 2);
-            vmWriter.WritePop(VMWriter::POINTER, 1);
-        }
-
-        // copy start of string as output
-        vmWriter.WritePush(VMWriter::POINTER, 1);
-
+        term = arena.Make<StringConstant>(std::string(jtok.StringVal()));
         jtok.Advance();
 
     } else if (tokenType == JackTokenizer::KEYWORD) {
@@ -884,42 +858,16 @@ void CompilationEngine::CompileTerm() {
             compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
         }
 
-        if (jtok.GetToken() == "null" || jtok.GetToken() == "false") {
-            // null and false map to constant 0
-            vmWriter.WritePush(VMWriter::CONST, 0);
-
-        } else if (jtok.GetToken() == "true") {
-            // true maps to -1 (i.e. all '1's in 2's complement binary)
-            vmWriter.WritePush(VMWriter::CONST, 1);
-            vmWriter.WriteArithmetic(VMWriter::NEG);
-
-        } else {
-            // "this" address pointed to by pointer 0
-            vmWriter.WritePush(VMWriter::POINTER, 0);
-        }
-
+        const auto keyword = keywordValues.find(jtok.GetToken());
+        term = arena.Make<KeywordConstant>(keyword->second);
         jtok.Advance();
 
     } else if (tokenType == JackTokenizer::IDENTIFIER) {
-        if (jtok.LookaheadToken() == "[") {
+        if (jtok.Peek(1) == "[") {
             // array dereference, syntax: varName '[' expression ']'
 
             // varName
-            const std::string varName = jtok.GetToken();
-            if (!symTable.Check(varName)) {
-                const std::string errMsg =
-                    "Variable " + varName + " not defined in current scope";
-                compilerErrorHandler.Report(currInputFile, jtok.LineNum(),
-                                            errMsg);
-            }
-
-            auto kind = symTable.KindOf(varName);
-            auto seg = kindToSegment.at(kind);
-            auto index = symTable.IndexOf(varName);
-
-            // const Category category = kindMap.at(kind);
-
-            // PrintIdentifier(category, USED);
+            const VarRef array = LookupVar();
 
             jtok.Advance();
 
@@ -927,40 +875,18 @@ void CompilationEngine::CompileTerm() {
             CheckLiteralSymbol("[", "expression term");
 
             // expression
-            CompileExpression();
-
-            vmWriter.WritePush(seg, index);
-            vmWriter.WriteArithmetic(VMWriter::ADD);
-
-            // get address of result into "that" pointer
-            vmWriter.WritePop(VMWriter::POINTER, 1);
-
-            // push dereferenced value onto the stack
-            vmWriter.WritePush(VMWriter::THAT, 0);
+            term = arena.Make<ArrayElement>(array, ParseExpression());
 
             // literal ']'
             CheckLiteralSymbol("]", "expression term");
 
-        } else if (jtok.LookaheadToken() == "(" ||
-                   jtok.LookaheadToken() == ".") {
+        } else if (jtok.Peek(1) == "(" || jtok.Peek(1) == ".") {
             // subroutine call
-            CompileSubroutineCall();
+            term = ParseSubroutineCall();
 
         } else {
             // varName
-            const std::string varName = jtok.GetToken();
-            if (!symTable.Check(varName)) {
-                const std::string errMsg =
-                    "Variable " + varName + " not defined in current scope";
-                compilerErrorHandler.Report(currInputFile, jtok.LineNum(),
-                                            errMsg);
-            }
-
-            auto kind = symTable.KindOf(varName);
-            auto index = symTable.IndexOf(varName);
-            VMWriter::Segment seg = kindToSegment.at(kind);
-
-            vmWriter.WritePush(seg, index);
+            term = arena.Make<Variable>(LookupVar());
 
             jtok.Advance();
         }
@@ -972,31 +898,31 @@ void CompilationEngine::CompileTerm() {
         CheckLiteralSymbol("(", "expression term");
 
         // expression
-        CompileExpression();
+        term = ParseExpression();
 
         // literal ')'
         CheckLiteralSymbol(")", "expression term");
 
     } else if (unaryOpTypes.find(jtok.GetToken()) != unaryOpTypes.end()) {
         // unaryOp
-        const auto currOp = jtok.GetToken();
+        const std::string currOp(jtok.GetToken());
         jtok.Advance();
 
         // term
-        CompileTerm();
-
-        vmWriter.WriteArithmetic(unaryOpCommands.at(currOp));
+        term = arena.Make<UnaryOp>(unaryOpCommands.at(currOp), ParseTerm());
 
     } else {
         // unrecognized input
         const std::string errMsg = "Unrecognized token in expression term";
         compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
     }
+
+    return term;
 }
 
 /* -------------------------------------------------------------------------- */
 
-int CompilationEngine::CompileExpressionList() {
+void CompilationEngine::ParseExpressionList(std::vector<Expression*>& list) {
     // syntax: (expression(',' expression)*)?
 
     // NOTE: this syntactic element only appears in subroutine calls and
@@ -1004,22 +930,31 @@ int CompilationEngine::CompileExpressionList() {
     //       Additionally, the only terminal in the language rules here is
     //       a literal ')'.
 
-    int expressionCount = 1;
-
     // expression
-    CompileExpression();
+    list.push_back(ParseExpression());
 
     // optional comma-separated expressions
     while (jtok.GetToken() != ")") {
         if (jtok.GetToken() == ",") {
             CheckLiteralSymbol(",", "expression list");
         } else {
-            ++expressionCount;
-            CompileExpression();
+            list.push_back(ParseExpression());
         }
     }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// storage for the variable named by the current token
+VarRef CompilationEngine::LookupVar() {
+    const auto var = symTable.Find(jtok.GetToken());
+    if (!var) {
+        const std::string errMsg = "Variable " + std::string(jtok.GetToken()) +
+                                   " not defined in current scope";
+        compilerErrorHandler.Report(currInputFile, jtok.LineNum(), errMsg);
+    }
 
-    return expressionCount;
+    return {var->segment, var->index};
 }
 
 /* -------------------------------------------------------------------------- */
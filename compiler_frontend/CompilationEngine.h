@@ -1,19 +1,27 @@
 #ifndef COMPILATION_ENGINE_H
 #define COMPILATION_ENGINE_H
 
+#include "Ast.h"
+#include "AstArena.h"
 #include "ErrorHandler.h"
 #include "JackTokenizer.h"
+#include "SignatureTable.h"
 #include "SymbolTable.h"
 #include "VMWriter.h"
 
 #include <fstream>
 #include <set>
 #include <string>
+#include <vector>
 
 class CompilationEngine {
   public:
     CompilationEngine(const std::string& infileName,
-                      const std::string& outfileName);
+                      const std::string& outfileName,
+                      const SignatureTable& programSignatures,
+                      const VMWriter::Format format = VMWriter::TEXT);
+    CompilationEngine(const std::string& infileName, VMSink& sink,
+                      const SignatureTable& programSignatures);
 
     // remove unwanted constructors
     CompilationEngine(const CompilationEngine& that) = delete;
@@ -23,17 +31,31 @@ class CompilationEngine {
 
     void CompileClass();
 
+    // expand calls to Memory.peek/poke and Array.new/dispose inline
+    void SetIntrinsics(const bool enable) { intrinsics = enable; }
+
+    // classes whose signatures the compiled code was checked against
+    const std::set<std::string>& ReferencedClasses() const {
+        return referencedClasses;
+    }
+
     // data
   private:
     std::string currInputFile;
     std::string currClass;
+    SubroutineDec::Kind currSubroutineKind;
     std::ofstream outFile;
-    unsigned loopCount;
-    unsigned branchCount;
     JackTokenizer jtok;
     ErrorHandler compilerErrorHandler;
     SymbolTable symTable;
+    const SignatureTable& signatures;
+    AstArena arena;
     VMWriter vmWriter;
+    bool intrinsics;
+    std::set<std::string> referencedClasses;
+
+    // sets compared directly against the tokenizer's string_view tokens
+    using TokenSet = std::set<std::string, std::less<>>;
 
     enum TagType { OPENING, CLOSING };
 
@@ -42,10 +64,6 @@ class CompilationEngine {
 
     std::string currIndent;
 
-    const std::string loopBase = "WHILE_LOOP";
-    const std::string branchBase = "IF_STATEMENT";
-    const std::string endPrefix = "END_";
-
     const std::map<JackTokenizer::Token, std::string> tokenString = {
         {JackTokenizer::KEYWORD, "keyword"},
         {JackTokenizer::SYMBOL, "symbol"},
@@ -64,19 +82,23 @@ class CompilationEngine {
         {SymbolTable::FIELD, FIELD},
         {SymbolTable::STATIC, STATIC}};
 
-    const std::map<SymbolTable::VARKIND, VMWriter::Segment> kindToSegment = {
-        {SymbolTable::VAR, VMWriter::LOCAL},
-        {SymbolTable::ARG, VMWriter::ARG},
-        {SymbolTable::FIELD, VMWriter::THIS},
-        {SymbolTable::STATIC, VMWriter::STATIC}};
+    const TokenSet validTypes = {"int", "char", "boolean"};
+    const TokenSet unaryOpTypes = {"-", "~"};
+    const TokenSet expressionOpTypes = {"+", "-", "*", "/", "&",
+                                        "|", "<", ">", "="};
+    const TokenSet expressionTerminals = {"]", ";", ",", ")"};
+    const TokenSet keywordConstants = {"true", "false", "null", "this"};
+
+    const std::map<std::string, KeywordConstant::Value, std::less<>>
+        keywordValues = {{"true", KeywordConstant::TRUE_VALUE},
+                         {"false", KeywordConstant::FALSE_VALUE},
+                         {"null", KeywordConstant::NULL_VALUE},
+                         {"this", KeywordConstant::THIS_VALUE}};
 
-    const std::set<std::string> validTypes = {"int", "char", "boolean"};
-    const std::set<std::string> unaryOpTypes = {"-", "~"};
-    const std::set<std::string> expressionOpTypes = {"+", "-", "*", "/", "&",
-                                                     "|", "<", ">", "="};
-    const std::set<std::string> expressionTerminals = {"]", ";", ",", ")"};
-    const std::set<std::string> keywordConstants = {"true", "false", "null",
-                                                    "this"};
+    const std::map<std::string, SubroutineDec::Kind> subroutineKinds = {
+        {"constructor", SubroutineDec::CONSTRUCTOR},
+        {"function", SubroutineDec::FUNCTION},
+        {"method", SubroutineDec::METHOD}};
 
     const std::map<std::string, VMWriter::Command> binaryOpCommands = {
         {"+", VMWriter::ADD}, {"-", VMWriter::SUB}, {"*", VMWriter::MULT},
@@ -101,24 +123,27 @@ class CompilationEngine {
     void CompileClassVarDec();
     void CompileVarDecCommon(const std::string& terminal,
                              const Category category);
-    void CompileSubroutine();
+    SubroutineDec* ParseSubroutine();
     void CompileParameterList();
-    void CompileSubroutineBody(const std::string& funcName,
-                               const std::string& funcType);
+    void ParseSubroutineBody(SubroutineDec* subroutine);
 
     void CompileVarDec();
 
-    void CompileStatements();
-    void CompileDo();
-    void CompileLet();
-    void CompileWhile();
-    void CompileReturn();
-    void CompileIf();
-
-    void CompileSubroutineCall();
-    void CompileExpression();
-    void CompileTerm();
-    int CompileExpressionList();
+    void ParseStatements(StatementList& statements);
+    Statement* ParseDo();
+    Statement* ParseLet();
+    Statement* ParseWhile();
+    Statement* ParseReturn();
+    Statement* ParseIf();
+
+    SubroutineCall* ParseSubroutineCall();
+    void ResolveCall(SubroutineCall* call, const std::string& className,
+                     const std::string& funcName, const unsigned line);
+    Expression* ParseExpression();
+    Expression* ParseTerm();
+    void ParseExpressionList(std::vector<Expression*>& list);
+
+    VarRef LookupVar();
 };
 
 #endif /* COMPILATION_ENGINE_H */
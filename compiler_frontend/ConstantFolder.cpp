@@ -0,0 +1,388 @@
+#include "ConstantFolder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+/* -------------------------------------------------------------------------- */
+
+ConstantFolder::ConstantFolder(AstArena& nodeArena) :
+        arena(nodeArena),
+        zeroStatics() {}
+
+/* -------------------------------------------------------------------------- */
+
+void ConstantFolder::FoldClass(ClassDec& classDec) {
+    zeroStatics.assign(static_cast<size_t>(classDec.nStatics), false);
+
+    for (auto subroutine : classDec.subroutines) {
+        FoldStatements(subroutine->body);
+    }
+
+    // statics are private to the class, so every write to them is visible
+    // here; fold again if some are known to stay 0
+    zeroStatics.assign(zeroStatics.size(), true);
+
+    for (const auto subroutine : classDec.subroutines) {
+        FindZeroStatics(subroutine->body);
+    }
+
+    if (std::find(zeroStatics.begin(), zeroStatics.end(), true) !=
+        zeroStatics.end()) {
+        for (auto subroutine : classDec.subroutines) {
+            FoldStatements(subroutine->body);
+        }
+    }
+
+    for (auto subroutine : classDec.subroutines) {
+        subroutine->fallsThrough = !EndsFlow(subroutine->body);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// folds every expression and drops statements that can never run
+void ConstantFolder::FoldStatements(StatementList& statements) {
+    StatementList live;
+    int condition = 0;
+
+    for (auto statement : statements) {
+        if (statement->kind == Statement::LET) {
+            auto let = static_cast<LetStatement*>(statement);
+            if (let->index) {
+                let->index = Fold(let->index);
+            }
+
+            let->value = Fold(let->value);
+
+        } else if (statement->kind == Statement::IF) {
+            auto branch = static_cast<IfStatement*>(statement);
+            branch->condition = Fold(branch->condition);
+            FoldStatements(branch->thenBody);
+            FoldStatements(branch->elseBody);
+
+            // NOTE: the branch is taken when "not condition" is 0, so only
+            //       true (-1) selects the then body
+            if (ConstantValue(branch->condition, condition)) {
+                const auto& taken =
+                    (condition == -1) ? branch->thenBody : branch->elseBody;
+                live.insert(live.end(), taken.begin(), taken.end());
+
+                if (EndsFlow(taken)) break;
+                continue;
+            }
+
+        } else if (statement->kind == Statement::WHILE) {
+            auto loop = static_cast<WhileStatement*>(statement);
+            loop->condition = Fold(loop->condition);
+            FoldStatements(loop->body);
+
+            if (ConstantValue(loop->condition, condition)) {
+                if (condition != -1) continue;
+
+                loop->condition = MakeConstant(-1);
+            }
+
+        } else if (statement->kind == Statement::DO) {
+            Fold(static_cast<DoStatement*>(statement)->call);
+
+        } else {
+            auto ret = static_cast<ReturnStatement*>(statement);
+            if (ret->value) {
+                ret->value = Fold(ret->value);
+            }
+        }
+
+        live.push_back(statement);
+
+        if (Terminates(statement)) break;
+    }
+
+    statements.swap(live);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// clears the entry of every static assigned anything other than 0
+void ConstantFolder::FindZeroStatics(const StatementList& statements) {
+    int value = 0;
+
+    for (const auto statement : statements) {
+        if (statement->kind == Statement::LET) {
+            const auto let = static_cast<const LetStatement*>(statement);
+            if (let->target.segment == VMWriter::STATIC && !let->index &&
+                !(ConstantValue(let->value, value) && value == 0)) {
+                zeroStatics[static_cast<size_t>(let->target.index)] = false;
+            }
+
+        } else if (statement->kind == Statement::IF) {
+            const auto branch = static_cast<const IfStatement*>(statement);
+            FindZeroStatics(branch->thenBody);
+            FindZeroStatics(branch->elseBody);
+
+        } else if (statement->kind == Statement::WHILE) {
+            const auto loop = static_cast<const WhileStatement*>(statement);
+            FindZeroStatics(loop->body);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// returns the expression to use in place of the given one
+Expression* ConstantFolder::Fold(Expression* expression) {
+    if (expression->kind == Expression::VARIABLE) {
+        const auto& var = static_cast<Variable*>(expression)->var;
+        if (var.segment == VMWriter::STATIC &&
+            zeroStatics[static_cast<size_t>(var.index)]) {
+            return MakeConstant(0);
+        }
+
+    } else if (expression->kind == Expression::ARRAY_ELEMENT) {
+        auto element = static_cast<ArrayElement*>(expression);
+        element->index = Fold(element->index);
+
+    } else if (expression->kind == Expression::CALL) {
+        auto call = static_cast<SubroutineCall*>(expression);
+        for (auto& argument : call->arguments) {
+            argument = Fold(argument);
+        }
+
+    } else if (expression->kind == Expression::UNARY) {
+        return FoldUnary(static_cast<UnaryOp*>(expression));
+
+    } else if (expression->kind == Expression::BINARY) {
+        return FoldBinary(static_cast<BinaryOp*>(expression));
+    }
+
+    return expression;
+}
+
+/* -------------------------------------------------------------------------- */
+
+Expression* ConstantFolder::FoldUnary(UnaryOp* unary) {
+    unary->operand = Fold(unary->operand);
+
+    int value = 0;
+    if (ConstantValue(unary->operand, value)) {
+        if (unary->op == VMWriter::NEG) {
+            return MakeConstant(ToWord(-value));
+        }
+
+        return MakeConstant(ToWord(~value));
+    }
+
+    // -(-x) and ~(~x) are both x
+    if (unary->operand->kind == Expression::UNARY &&
+        static_cast<UnaryOp*>(unary->operand)->op == unary->op) {
+        return static_cast<UnaryOp*>(unary->operand)->operand;
+    }
+
+    return unary;
+}
+
+/* -------------------------------------------------------------------------- */
+
+Expression* ConstantFolder::FoldBinary(BinaryOp* binary) {
+    binary->left = Fold(binary->left);
+    binary->right = Fold(binary->right);
+
+    int x = 0;
+    int y = 0;
+    const bool leftConst = ConstantValue(binary->left, x);
+    const bool rightConst = ConstantValue(binary->right, y);
+
+    if (leftConst && rightConst) {
+        // NOTE: comparisons follow the translator, which tests the sign of
+        //       the wrapped difference x - y
+        const auto op = binary->op;
+        if (op == VMWriter::ADD) {
+            return MakeConstant(ToWord(x + y));
+
+        } else if (op == VMWriter::SUB) {
+            return MakeConstant(ToWord(x - y));
+
+        } else if (op == VMWriter::MULT) {
+            return MakeConstant(ToWord(x * y));
+
+        } else if (op == VMWriter::DIV) {
+            // division by zero is left for Math.divide to report
+            if (y != 0 && !(x == -32768 && y == -1)) {
+                return MakeConstant(x / y);
+            }
+
+        } else if (op == VMWriter::AND) {
+            return MakeConstant(x & y);
+
+        } else if (op == VMWriter::OR) {
+            return MakeConstant(x | y);
+
+        } else if (op == VMWriter::EQ) {
+            return MakeConstant((x == y) ? -1 : 0);
+
+        } else if (op == VMWriter::GT) {
+            return MakeConstant((ToWord(x - y) > 0) ? -1 : 0);
+
+        } else if (op == VMWriter::LT) {
+            return MakeConstant((ToWord(x - y) < 0) ? -1 : 0);
+        }
+
+        return binary;
+    }
+
+    if (leftConst) {
+        // constant operands go on the right, since "push constant" followed
+        // by the operator is what the translator expands inline
+        if (IsCommutative(binary->op)) {
+            std::swap(binary->left, binary->right);
+
+        } else if (binary->op == VMWriter::LT || binary->op == VMWriter::GT) {
+            std::swap(binary->left, binary->right);
+            binary->op = (binary->op == VMWriter::LT) ? VMWriter::GT
+                                                      : VMWriter::LT;
+
+        } else if (binary->op == VMWriter::SUB && x == 0) {
+            return arena.Make<UnaryOp>(VMWriter::NEG, binary->right);
+        }
+    }
+
+    return FoldIdentity(binary);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// x op c where c is a constant identity or absorbing element for op
+Expression* ConstantFolder::FoldIdentity(BinaryOp* binary) {
+    int c = 0;
+    if (!ConstantValue(binary->right, c)) {
+        return binary;
+    }
+
+    Expression* x = binary->left;
+    const auto op = binary->op;
+
+    if (op == VMWriter::ADD || op == VMWriter::SUB) {
+        if (c == 0) return x;
+
+    } else if (op == VMWriter::MULT) {
+        if (c == 0 && IsPure(x)) return MakeConstant(0);
+        if (c == 1) return x;
+        if (c == -1) return arena.Make<UnaryOp>(VMWriter::NEG, x);
+
+        // a variable is cheap to push twice, x * 2 -> x + x
+        if (c == 2 && x->kind == Expression::VARIABLE) {
+            return arena.Make<BinaryOp>(VMWriter::ADD, x, x);
+        }
+
+    } else if (op == VMWriter::DIV) {
+        if (c == 1) return x;
+        if (c == -1) return arena.Make<UnaryOp>(VMWriter::NEG, x);
+
+    } else if (op == VMWriter::AND) {
+        if (c == 0 && IsPure(x)) return MakeConstant(0);
+        if (c == -1) return x;
+
+    } else if (op == VMWriter::OR) {
+        if (c == 0) return x;
+        if (c == -1 && IsPure(x)) return MakeConstant(-1);
+    }
+
+    return binary;
+}
+
+/* -------------------------------------------------------------------------- */
+
+Expression* ConstantFolder::MakeConstant(const int value) {
+    return arena.Make<IntConstant>(value);
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool ConstantFolder::ConstantValue(const Expression* expression, int& value) {
+    if (expression->kind == Expression::INT_CONST) {
+        value = static_cast<const IntConstant*>(expression)->value;
+        return true;
+    }
+
+    if (expression->kind == Expression::KEYWORD_CONST) {
+        const auto keyword = static_cast<const KeywordConstant*>(expression);
+        if (keyword->value == KeywordConstant::THIS_VALUE) {
+            return false;
+        }
+
+        value = (keyword->value == KeywordConstant::TRUE_VALUE) ? -1 : 0;
+        return true;
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// true if evaluating the expression has no effect besides its value, so it
+// may be dropped (calls and string literals allocate or have side effects)
+bool ConstantFolder::IsPure(const Expression* expression) {
+    const auto kind = expression->kind;
+
+    if (kind == Expression::INT_CONST || kind == Expression::KEYWORD_CONST ||
+        kind == Expression::VARIABLE) {
+        return true;
+
+    } else if (kind == Expression::ARRAY_ELEMENT) {
+        return IsPure(static_cast<const ArrayElement*>(expression)->index);
+
+    } else if (kind == Expression::UNARY) {
+        return IsPure(static_cast<const UnaryOp*>(expression)->operand);
+
+    } else if (kind == Expression::BINARY) {
+        const auto binary = static_cast<const BinaryOp*>(expression);
+        return binary->op != VMWriter::DIV && IsPure(binary->left) &&
+               IsPure(binary->right);
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// reduce a result to a signed 16-bit Hack word
+int ConstantFolder::ToWord(const int value) {
+    return static_cast<int16_t>(static_cast<uint16_t>(value & 0xFFFF));
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool ConstantFolder::IsCommutative(const VMWriter::Command op) {
+    return op == VMWriter::ADD || op == VMWriter::MULT ||
+           op == VMWriter::AND || op == VMWriter::OR || op == VMWriter::EQ;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// true if control never reaches the statement after this one; lists have
+// already been cut after their first such statement
+bool ConstantFolder::Terminates(const Statement* statement) {
+    if (statement->kind == Statement::RETURN) {
+        return true;
+
+    } else if (statement->kind == Statement::IF) {
+        const auto branch = static_cast<const IfStatement*>(statement);
+        return EndsFlow(branch->thenBody) && EndsFlow(branch->elseBody);
+
+    } else if (statement->kind == Statement::WHILE) {
+        // Jack has no break, so a loop that always runs only ends by returning
+        const auto loop = static_cast<const WhileStatement*>(statement);
+        int condition = 0;
+        return ConstantValue(loop->condition, condition) && condition == -1;
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool ConstantFolder::EndsFlow(const StatementList& statements) {
+    return !statements.empty() && Terminates(statements.back());
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,61 @@
+#ifndef CONSTANT_FOLDER_H
+#define CONSTANT_FOLDER_H
+
+#include "Ast.h"
+#include "AstArena.h"
+
+#include <vector>
+
+// Rewrites the expressions of a parsed class before code generation:
+// constant subexpressions are evaluated with 16-bit Hack arithmetic,
+// identity operands are dropped, and cheap forms are chosen for multiplies
+// by small constants. Constants are moved to the right of commutative
+// operators and comparisons, where the VM translator expands them inline.
+//
+// Statements are pruned as well: an if or while whose condition folds to a
+// constant keeps only the branch that can run, and statements after a return
+// (or after an if whose branches both return, or a while (true)) are dropped.
+// A static the class only ever assigns false (or never assigns) reads as 0,
+// so "if (DEBUG)" blocks controlled by such a flag disappear.
+class ConstantFolder {
+  public:
+    ConstantFolder(AstArena& nodeArena);
+
+    // remove unwanted constructors
+    ConstantFolder(const ConstantFolder& that) = delete;
+    ConstantFolder(const ConstantFolder&& that) = delete;
+    ConstantFolder& operator=(const ConstantFolder& that) = delete;
+    ConstantFolder& operator=(const ConstantFolder&& that) = delete;
+
+    void FoldClass(ClassDec& classDec);
+
+    // true if evaluating the expression has no effect besides its value
+    static bool IsPure(const Expression* expression);
+
+    // data
+  private:
+    AstArena& arena;
+
+    // static variables known to hold 0, indexed by static index
+    std::vector<bool> zeroStatics;
+
+    // methods
+  private:
+    void FoldStatements(StatementList& statements);
+    void FindZeroStatics(const StatementList& statements);
+
+    Expression* Fold(Expression* expression);
+    Expression* FoldUnary(UnaryOp* unary);
+    Expression* FoldBinary(BinaryOp* binary);
+    Expression* FoldIdentity(BinaryOp* binary);
+
+    Expression* MakeConstant(const int value);
+    static bool ConstantValue(const Expression* expression, int& value);
+    static bool IsCommutative(const VMWriter::Command op);
+    static int ToWord(const int value);
+
+    static bool Terminates(const Statement* statement);
+    static bool EndsFlow(const StatementList& statements);
+};
+
+#endif /* CONSTANT_FOLDER_H */
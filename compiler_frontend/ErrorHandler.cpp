@@ -1,26 +1,26 @@
 #include "ErrorHandler.h"
 
-#include <cstdlib>
-#include <iostream>
+#include <sstream>
 
 /* -------------------------------------------------------------------------- */
 
 void ErrorHandler::Report(const std::string& file, const unsigned line,
                           const std::string& message) {
-    std::cerr << "[file "
-              << "\"" << file << "\", line " << line << "] Error: " << message
-              << '\n';
-    std::exit(65);
+    std::ostringstream report;
+    report << "[file "
+           << "\"" << file << "\", line " << line << "] Error: " << message;
+    throw CompileError(report.str(), 65);
 }
 
 /* -------------------------------------------------------------------------- */
 
 void ErrorHandler::Report(const std::string& file, const unsigned line,
                           const size_t col, const std::string& message) {
-    std::cerr << "[file "
-              << "\"" << file << "\", line " << line << ", column " << col
-              << "] Error: " << message << '\n';
-    std::exit(65);
+    std::ostringstream report;
+    report << "[file "
+           << "\"" << file << "\", line " << line << ", column " << col
+           << "] Error: " << message;
+    throw CompileError(report.str(), 65);
 }
 
 /* -------------------------------------------------------------------------- */
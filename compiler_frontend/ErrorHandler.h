@@ -1,8 +1,25 @@
 #ifndef ERROR_HANDLER_H
 #define ERROR_HANDLER_H
 
+#include <stdexcept>
 #include <string>
 
+// Thrown for any error that ends compilation of the current file. The driver
+// prints the message and exits with the given status, or records the failure
+// and moves on to the next file when compiling a batch.
+class CompileError : public std::runtime_error {
+  public:
+    CompileError(const std::string& message, const int exitStatus) :
+            std::runtime_error(message),
+            status(exitStatus) {}
+
+    int Status() const { return status; }
+
+    // data
+  private:
+    int status;
+};
+
 class ErrorHandler {
   public:
     void Report(const std::string& file, const unsigned line,
@@ -0,0 +1,120 @@
+#include "ExpressionScheduler.h"
+#include "ConstantFolder.h"
+
+#include <algorithm>
+#include <utility>
+
+/* -------------------------------------------------------------------------- */
+
+ExpressionScheduler::ExpressionScheduler() {}
+
+/* -------------------------------------------------------------------------- */
+
+void ExpressionScheduler::ScheduleClass(ClassDec& classDec) {
+    for (auto subroutine : classDec.subroutines) {
+        ScheduleStatements(subroutine->body);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void ExpressionScheduler::ScheduleStatements(StatementList& statements) {
+    for (auto statement : statements) {
+        if (statement->kind == Statement::LET) {
+            auto let = static_cast<LetStatement*>(statement);
+            if (let->index) {
+                Schedule(let->index);
+            }
+
+            Schedule(let->value);
+
+        } else if (statement->kind == Statement::IF) {
+            auto branch = static_cast<IfStatement*>(statement);
+            Schedule(branch->condition);
+            ScheduleStatements(branch->thenBody);
+            ScheduleStatements(branch->elseBody);
+
+        } else if (statement->kind == Statement::WHILE) {
+            auto loop = static_cast<WhileStatement*>(statement);
+            Schedule(loop->condition);
+            ScheduleStatements(loop->body);
+
+        } else if (statement->kind == Statement::DO) {
+            Schedule(static_cast<DoStatement*>(statement)->call);
+
+        } else {
+            auto ret = static_cast<ReturnStatement*>(statement);
+            if (ret->value) {
+                Schedule(ret->value);
+            }
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// reorders the expression's operators and returns the most stack slots it
+// occupies while being evaluated, counting its result
+int ExpressionScheduler::Schedule(Expression* expression) {
+    if (expression->kind == Expression::ARRAY_ELEMENT) {
+        // a constant index is a single "that" push, otherwise the base is
+        // pushed on top of the index and added to it
+        auto element = static_cast<ArrayElement*>(expression);
+        const int indexNeed = Schedule(element->index);
+        if (element->index->kind == Expression::INT_CONST &&
+            static_cast<IntConstant*>(element->index)->value >= 0) {
+            return 1;
+        }
+
+        return std::max(indexNeed, 2);
+
+    } else if (expression->kind == Expression::CALL) {
+        // receiver and arguments stay on the stack until the call
+        auto call = static_cast<SubroutineCall*>(expression);
+        int depth = (call->receiver == SubroutineCall::NONE) ? 0 : 1;
+        int need = std::max(depth, 1);
+
+        for (auto argument : call->arguments) {
+            need = std::max(need, depth + Schedule(argument));
+            ++depth;
+        }
+
+        return need;
+
+    } else if (expression->kind == Expression::UNARY) {
+        return Schedule(static_cast<UnaryOp*>(expression)->operand);
+
+    } else if (expression->kind == Expression::BINARY) {
+        return ScheduleBinary(static_cast<BinaryOp*>(expression));
+    }
+
+    // constants and variables are a single push
+    return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int ExpressionScheduler::ScheduleBinary(BinaryOp* binary) {
+    int leftNeed = Schedule(binary->left);
+    int rightNeed = Schedule(binary->right);
+
+    // a constant on the right needs one slot, so it always stays there
+    if (rightNeed > leftNeed && IsReorderable(binary->op) &&
+        ConstantFolder::IsPure(binary->left) &&
+        ConstantFolder::IsPure(binary->right)) {
+        std::swap(binary->left, binary->right);
+        std::swap(leftNeed, rightNeed);
+    }
+
+    // the left result sits under the right operand while it is evaluated
+    return std::max(leftNeed, rightNeed + 1);
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool ExpressionScheduler::IsReorderable(const VMWriter::Command op) {
+    return op == VMWriter::ADD || op == VMWriter::MULT ||
+           op == VMWriter::AND || op == VMWriter::OR || op == VMWriter::EQ;
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,35 @@
+#ifndef EXPRESSION_SCHEDULER_H
+#define EXPRESSION_SCHEDULER_H
+
+#include "Ast.h"
+
+// Orders the operands of commutative operators so that each expression
+// needs as few stack slots as possible (Sethi-Ullman numbering): the operand
+// that needs more slots is evaluated first, while the stack holds nothing
+// else of the expression. Only +, *, &, | and = are reordered, and only when
+// both operands are pure, since swapping them changes the order in which
+// they are evaluated. Runs after ConstantFolder, and never moves a constant
+// off the right-hand side, where the VM translator expands it inline.
+class ExpressionScheduler {
+  public:
+    ExpressionScheduler();
+
+    // remove unwanted constructors
+    ExpressionScheduler(const ExpressionScheduler& that) = delete;
+    ExpressionScheduler(const ExpressionScheduler&& that) = delete;
+    ExpressionScheduler& operator=(const ExpressionScheduler& that) = delete;
+    ExpressionScheduler& operator=(const ExpressionScheduler&& that) = delete;
+
+    void ScheduleClass(ClassDec& classDec);
+
+    // methods
+  private:
+    void ScheduleStatements(StatementList& statements);
+
+    int Schedule(Expression* expression);
+    int ScheduleBinary(BinaryOp* binary);
+
+    static bool IsReorderable(const VMWriter::Command op);
+};
+
+#endif /* EXPRESSION_SCHEDULER_H */
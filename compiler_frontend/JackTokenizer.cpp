@@ -1,222 +1,316 @@
 #include "JackTokenizer.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <cctype>
 #include <cstdlib>
-#include <iostream>
-#include <sstream>
 
 /* -------------------------------------------------------------------------- */
 
 JackTokenizer::JackTokenizer(const std::string& fileName) :
-        inFile(fileName),
         fname(fileName),
-        currLineNum(0),
-        currColumnNum(0),
-        currLine(),
-        moreTokens(true),
-        currToken(),
-        currTokenType(),
-        currKeyword(),
-        currSymbol(),
-        currIdentifier(),
-        currIntVal(),
-        currStringVal(),
+        mapBegin(nullptr),
+        mapEnd(nullptr),
+        pos(nullptr),
+        lineStart(nullptr),
+        currLineNum(1),
+        ring(),
+        ringHead(0),
+        ringCount(0),
         tokErrHandler() {
-    if (!inFile.is_open()) {
-        std::cerr << "ERROR: Could not open file \"" << fileName << "\"\n";
-        std::exit(EXIT_FAILURE);
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat info;
+
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) close(fd);
+
+        throw CompileError("ERROR: Could not open file \"" + fileName + "\"",
+                           EXIT_FAILURE);
     }
-}
 
-/* -------------------------------------------------------------------------- */
+    const size_t size = static_cast<size_t>(info.st_size);
 
-void JackTokenizer::Advance() {
-    do {
-        AdvanceDriver();
-    } while (currTokenType == COMMENT || currTokenType == SPACE);
-}
+    if (size > 0) {
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
 
-/* -------------------------------------------------------------------------- */
+        if (data == MAP_FAILED) {
+            close(fd);
 
-void JackTokenizer::AdvanceDriver() {
-    // read new line if necessary and check for EOF
-    if (currLine.empty() || currColumnNum >= currLine.size()) {
-        ReadNextLine();
-        if (!inFile.good()) {
-            currTokenType = EMPTY;
-            return;
+            throw CompileError("ERROR: Could not map file \"" + fileName + "\"",
+                               EXIT_FAILURE);
         }
-    }
 
-    if (currLine.empty()) {
-        currTokenType = SPACE;
-        return;
+        mapBegin = static_cast<const char*>(data);
     }
 
-    // skip spaces
-    while (currLine[currColumnNum] == ' ' || currLine[currColumnNum] == '\t') {
-        ++currColumnNum;
+    close(fd);
 
-        if (currColumnNum >= currLine.size()) {
-            currTokenType = SPACE;
-            ReadNextLine();
-            return;
-        }
-    }
+    mapEnd = mapBegin + size;
+    pos = mapBegin;
+    lineStart = mapBegin;
+}
 
-    // check for comments
-    if ((currLine[currColumnNum] == '/') &&
-        (currLine[currColumnNum + 1] == '/' ||
-         currLine[currColumnNum + 1] == '*')) {
-        if (currLine[currColumnNum + 1] == '/') {
-            currTokenType = COMMENT;
-            ReadNextLine();
-        } else if (currLine[currColumnNum + 1] == '*') {
-            currTokenType = COMMENT;
-            currColumnNum += 2;
-            ParseDelimitedComment();
-        }
-    }
+/* -------------------------------------------------------------------------- */
 
-    // check for symbols
-    else if (symbolSet.find(currLine[currColumnNum]) != symbolSet.end()) {
-        currToken = currLine[currColumnNum];
-        currSymbol = currLine[currColumnNum];
-        currTokenType = SYMBOL;
-        ++currColumnNum;
+JackTokenizer::~JackTokenizer() {
+    if (mapBegin) {
+        munmap(const_cast<char*>(mapBegin),
+               static_cast<size_t>(mapEnd - mapBegin));
     }
+}
 
-    // check for string literals
-    else if (currLine[currColumnNum] == '"') {
-        ++currColumnNum;
-        ParseStringLiteral();
-    }
+/* -------------------------------------------------------------------------- */
 
-    // check for int literals
-    else if (std::isdigit(currLine[currColumnNum])) {
-        ParseIntLiteral();
+// moves to the next token, reusing it from the ring if it was peeked
+void JackTokenizer::Advance() {
+    if (ringCount > 1) {
+        ringHead = (ringHead + 1) % ring.size();
+        --ringCount;
+        return;
     }
 
-    // parse keywords from identifiers
-    else {
-        ParseKeywordIdentifier();
-    }
+    Lex(ring[ringHead]);
+    ringCount = 1;
 }
 
 /* -------------------------------------------------------------------------- */
 
-std::string JackTokenizer::LookaheadToken() const {
-    auto localColNum = currColumnNum;
+// text of the token k places after the current one (Peek(0) is the current
+// token), empty past the end of the file
+std::string_view JackTokenizer::Peek(const size_t k) {
+    if (k > maxLookahead) {
+        throw CompileError("ERROR: tokenizer lookahead of " +
+                               std::to_string(k) + " exceeds " +
+                               std::to_string(maxLookahead),
+                           EXIT_FAILURE);
+    }
 
-    while (std::isspace(currLine[localColNum])) {
-        ++localColNum;
+    while (ringCount <= k) {
+        Lex(ring[(ringHead + ringCount) % ring.size()]);
+        ++ringCount;
     }
 
-    std::stringstream ss;
-    ss << currLine[localColNum];
-    return ss.str();
+    return ring[(ringHead + k) % ring.size()].text;
 }
 
 /* -------------------------------------------------------------------------- */
 
-void JackTokenizer::ReadNextLine() {
-    std::getline(inFile, currLine);
-    ++currLineNum;
-    currColumnNum = 0;
+void JackTokenizer::Lex(Lexeme& lexeme) {
+    SkipSpace();
 
-    if (!inFile.good()) {
-        moreTokens = false;
+    lexeme.line = currLineNum;
+    lexeme.column = static_cast<size_t>(pos - lineStart) + 1;
+    lexeme.offset = static_cast<size_t>(pos - mapBegin);
+
+    if (pos == mapEnd) {
+        lexeme.text = std::string_view();
+        lexeme.type = EMPTY;
+        return;
     }
-}
 
-/* -------------------------------------------------------------------------- */
+    const char c = *pos;
 
-void JackTokenizer::ParseDelimitedComment() {
-    unsigned originalLineNum = currLineNum;
+    if (symbolTable[static_cast<unsigned char>(c)]) {
+        lexeme.text = std::string_view(pos, 1);
+        lexeme.symbol = c;
+        lexeme.type = SYMBOL;
+        ++pos;
 
-    auto commentEnd = currLine.find(multiCommentCloser, currColumnNum);
-    while (commentEnd == std::string::npos) {
-        ReadNextLine();
-        ++currLineNum;
-        currColumnNum = 0;
+    } else if (c == '"') {
+        ParseStringLiteral(lexeme);
 
-        // unexpected EOF
-        if (!inFile.good()) {
-            const std::string errMsg = "Unclosed multi-line comment";
-            tokErrHandler.Report(fname, originalLineNum, errMsg);
-        }
+    } else if (std::isdigit(static_cast<unsigned char>(c))) {
+        ParseIntLiteral(lexeme);
 
-        commentEnd = currLine.find(multiCommentCloser, currColumnNum);
+    } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+        ParseKeywordIdentifier(lexeme);
+
+    } else {
+        const std::string errMsg = "Unexpected character in source";
+        tokErrHandler.Report(fname, currLineNum, lexeme.column, errMsg);
     }
+}
 
-    currTokenType = COMMENT;
-    currColumnNum = commentEnd + 2;
+/* -------------------------------------------------------------------------- */
+
+// moves the scan position past whitespace and comments, counting lines
+void JackTokenizer::SkipSpace() {
+    while (pos < mapEnd) {
+        const char c = *pos;
+
+        if (c == '\n') {
+            ++pos;
+            ++currLineNum;
+            lineStart = pos;
+
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' ||
+                   c == '\v') {
+            ++pos;
+
+        } else if (c == '/' && pos + 1 < mapEnd && pos[1] == '/') {
+            // line comment runs up to the newline, which is counted above
+            while (pos < mapEnd && *pos != '\n') {
+                ++pos;
+            }
+
+        } else if (c == '/' && pos + 1 < mapEnd && pos[1] == '*') {
+            const unsigned commentLine = currLineNum;
+            pos += 2;
+
+            while (pos + 1 < mapEnd && !(pos[0] == '*' && pos[1] == '/')) {
+                if (*pos == '\n') {
+                    ++currLineNum;
+                    lineStart = pos + 1;
+                }
+                ++pos;
+            }
+
+            if (pos + 1 >= mapEnd) {
+                const std::string errMsg = "Unclosed multi-line comment";
+                tokErrHandler.Report(fname, commentLine, errMsg);
+            }
+
+            pos += 2;
+
+        } else {
+            break;
+        }
+    }
 }
 
 /* -------------------------------------------------------------------------- */
 
-void JackTokenizer::ParseStringLiteral() {
-    size_t startPos = currColumnNum;
-    size_t endQuotePos = currLine.find('"', currColumnNum);
+void JackTokenizer::ParseStringLiteral(Lexeme& lexeme) {
+    // string literals may not span lines
+    const char* start = pos + 1;
+    const char* endQuote = start;
 
-    if (endQuotePos == std::string::npos) {
+    while (endQuote < mapEnd && *endQuote != '"' && *endQuote != '\n') {
+        ++endQuote;
+    }
+
+    if (endQuote == mapEnd || *endQuote != '"') {
         const std::string errMsg = "Unclosed string literal";
         tokErrHandler.Report(fname, currLineNum, errMsg);
     }
 
-    currStringVal = currLine.substr(startPos, endQuotePos - startPos);
-    currToken = currStringVal;
-    currTokenType = STRING_CONST;
+    lexeme.text =
+        std::string_view(start, static_cast<size_t>(endQuote - start));
+    lexeme.type = STRING_CONST;
 
-    currColumnNum = endQuotePos + 1;
+    pos = endQuote + 1;
 }
 
 /* -------------------------------------------------------------------------- */
 
-void JackTokenizer::ParseIntLiteral() {
-    std::stringstream intStream;
+void JackTokenizer::ParseIntLiteral(Lexeme& lexeme) {
+    const char* start = pos;
+    int value = 0;
 
-    while (std::isdigit(currLine[currColumnNum])) {
-        intStream << currLine[currColumnNum];
-        ++currColumnNum;
+    while (pos < mapEnd && std::isdigit(static_cast<unsigned char>(*pos))) {
+        value = value * 10 + (*pos - '0');
+        ++pos;
 
-        if (currColumnNum >= currLine.size()) {
-            const std::string errMsg = "Missing semicolon after int literal";
-            tokErrHandler.Report(fname, currLineNum, currColumnNum + 1, errMsg);
+        if (value > maxIntConstant) {
+            const std::string errMsg = "Integer constant too large";
+            tokErrHandler.Report(fname, currLineNum, lexeme.column, errMsg);
         }
     }
 
-    currToken = intStream.str();
-    currTokenType = INT_CONST;
-    currIntVal = std::stoi(intStream.str());
+    lexeme.text = std::string_view(start, static_cast<size_t>(pos - start));
+    lexeme.type = INT_CONST;
+    lexeme.intVal = value;
 }
 
 /* -------------------------------------------------------------------------- */
 
-void JackTokenizer::ParseKeywordIdentifier() {
-    std::stringstream textStream;
+void JackTokenizer::ParseKeywordIdentifier(Lexeme& lexeme) {
+    const char* start = pos;
 
-    while (std::isalnum(currLine[currColumnNum]) ||
-           currLine[currColumnNum] == '_') {
-        textStream << currLine[currColumnNum];
-        ++currColumnNum;
+    while (pos < mapEnd &&
+           (std::isalnum(static_cast<unsigned char>(*pos)) || *pos == '_')) {
+        ++pos;
+    }
 
-        if (currColumnNum >= currLine.size()) {
-            const std::string errMsg = "Missing semicolon";
-            tokErrHandler.Report(fname, currLineNum, currColumnNum, errMsg);
-        }
+    lexeme.text = std::string_view(start, static_cast<size_t>(pos - start));
+
+    if (ClassifyKeyword(lexeme.text, lexeme.keyword)) {
+        lexeme.type = KEYWORD;
+    } else {
+        lexeme.type = IDENTIFIER;
     }
+}
 
-    currToken = textStream.str();
+/* -------------------------------------------------------------------------- */
 
-    if (keywordMap.find(currToken) != keywordMap.end()) {
-        currTokenType = KEYWORD;
-        currKeyword = keywordMap.at(currToken);
+std::array<bool, 256> JackTokenizer::MakeSymbolTable(const std::string& chars) {
+    std::array<bool, 256> table{};
 
-    } else {
-        currTokenType = IDENTIFIER;
-        currIdentifier = currToken;
+    for (const char c : chars) {
+        table[static_cast<unsigned char>(c)] = true;
     }
+
+    return table;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// keywords are told apart by their first letter, leaving at most three
+// candidates to compare against
+bool JackTokenizer::ClassifyKeyword(const std::string_view word,
+                                    Keyword& keyword) {
+    switch (word.front()) {
+        case 'b':
+            return MatchKeyword(word, "boolean", BOOLEAN, keyword);
+        case 'c':
+            return MatchKeyword(word, "class", CLASS, keyword) ||
+                   MatchKeyword(word, "char", CHAR, keyword) ||
+                   MatchKeyword(word, "constructor", CONSTRUCTOR, keyword);
+        case 'd':
+            return MatchKeyword(word, "do", DO, keyword);
+        case 'e':
+            return MatchKeyword(word, "else", ELSE, keyword);
+        case 'f':
+            return MatchKeyword(word, "function", FUNCTION, keyword) ||
+                   MatchKeyword(word, "field", FIELD, keyword) ||
+                   MatchKeyword(word, "false", FALSE, keyword);
+        case 'i':
+            return MatchKeyword(word, "int", INT, keyword) ||
+                   MatchKeyword(word, "if", IF, keyword);
+        case 'l':
+            return MatchKeyword(word, "let", LET, keyword);
+        case 'm':
+            return MatchKeyword(word, "method", METHOD, keyword);
+        case 'n':
+            return MatchKeyword(word, "null", NULL_KEY, keyword);
+        case 'r':
+            return MatchKeyword(word, "return", RETURN, keyword);
+        case 's':
+            return MatchKeyword(word, "static", STATIC, keyword);
+        case 't':
+            return MatchKeyword(word, "true", TRUE, keyword) ||
+                   MatchKeyword(word, "this", THIS, keyword);
+        case 'v':
+            return MatchKeyword(word, "void", VOID, keyword) ||
+                   MatchKeyword(word, "var", VAR, keyword);
+        case 'w':
+            return MatchKeyword(word, "while", WHILE, keyword);
+        default:
+            return false;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool JackTokenizer::MatchKeyword(const std::string_view word, const char* text,
+                                 const Keyword candidate, Keyword& keyword) {
+    if (word != text) return false;
+
+    keyword = candidate;
+    return true;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -3,14 +3,14 @@
 
 #include "ErrorHandler.h"
 
-#include <fstream>
-#include <map>
-#include <set>
+#include <array>
 #include <string>
+#include <string_view>
 
 class JackTokenizer {
   public:
     JackTokenizer(const std::string& fileName);
+    ~JackTokenizer();
 
     // remove unwanted constructors
     JackTokenizer(const JackTokenizer& that) = delete;
@@ -55,76 +55,73 @@ class JackTokenizer {
     };
 
     // public interface
-    bool HasMoreTokens() const { return moreTokens; }
+    bool HasMoreTokens() const { return Current().type != EMPTY; }
     void Advance();
-    Token TokenType() const { return currTokenType; }
-    std::string GetToken() const { return currToken; }
-    std::string LookaheadToken() const;
-    Keyword KeywordType() const { return currKeyword; }
-    char Symbol() const { return currSymbol; }
-    std::string Identifier() const { return currIdentifier; }
-    int IntVal() const { return currIntVal; }
-    std::string StringVal() const { return currStringVal; }
-    unsigned LineNum() const { return currLineNum; }
-    size_t ColNum() const { return currColumnNum; }
+    std::string_view Peek(const size_t k);
+    Token TokenType() const { return Current().type; }
+    std::string_view GetToken() const { return Current().text; }
+    Keyword KeywordType() const { return Current().keyword; }
+    char Symbol() const { return Current().symbol; }
+    std::string_view Identifier() const { return Current().text; }
+    int IntVal() const { return Current().intVal; }
+    std::string_view StringVal() const { return Current().text; }
+    unsigned LineNum() const { return Current().line; }
+    size_t ColNum() const { return Current().column; }
+    size_t Offset() const { return Current().offset; }
+
+    // largest k that Peek accepts
+    static constexpr size_t maxLookahead = 7;
 
     // data
   private:
-    std::ifstream inFile;
+    // one pre-lexed token, text is a view into the mapped source
+    struct Lexeme {
+        std::string_view text;
+        Token type = EMPTY;
+        Keyword keyword = CLASS;
+        char symbol = '\0';
+        int intVal = 0;
+        unsigned line = 0;
+        size_t column = 0;
+        size_t offset = 0;
+    };
+
     std::string fname;
-    unsigned currLineNum;
-    size_t currColumnNum;
 
-    std::string currLine;
+    // the whole source file is mapped, the scan position runs ahead of the
+    // current token by however many tokens have been peeked
+    const char* mapBegin;
+    const char* mapEnd;
+    const char* pos;
+    const char* lineStart;
+    unsigned currLineNum;
 
-    bool moreTokens;
-    std::string currToken;
-    Token currTokenType;
-    Keyword currKeyword;
-    char currSymbol;
-    std::string currIdentifier;
-    int currIntVal;
-    std::string currStringVal;
+    // current token at ringHead, followed by ringCount - 1 peeked tokens
+    std::array<Lexeme, maxLookahead + 1> ring;
+    size_t ringHead;
+    size_t ringCount;
 
     ErrorHandler tokErrHandler;
 
-    const std::string multiCommentCloser = "*/";
-
-    const std::set<char> symbolSet = {'{', '}', '(', ')', '[', ']', '.',
-                                      ',', ';', '+', '-', '*', '/', '&',
-                                      '|', '<', '>', '=', '~'};
-
-    const std::map<std::string, Keyword> keywordMap = {
-        {"class", CLASS},
-        {"method", METHOD},
-        {"function", FUNCTION},
-        {"constructor", CONSTRUCTOR},
-        {"int", INT},
-        {"boolean", BOOLEAN},
-        {"char", CHAR},
-        {"void", VOID},
-        {"var", VAR},
-        {"static", STATIC},
-        {"field", FIELD},
-        {"let", LET},
-        {"do", DO},
-        {"if", IF},
-        {"else", ELSE},
-        {"while", WHILE},
-        {"return", RETURN},
-        {"true", TRUE},
-        {"false", FALSE},
-        {"null", NULL_KEY},
-        {"this", THIS}};
+    const std::string symbols = "{}()[].,;+-*/&|<>=~";
+    const std::array<bool, 256> symbolTable = MakeSymbolTable(symbols);
+
+    const int maxIntConstant = 32767;
 
     // methods
   private:
-    void AdvanceDriver();
-    void ReadNextLine();
-    void ParseDelimitedComment();
-    void ParseStringLiteral();
-    void ParseIntLiteral();
-    void ParseKeywordIdentifier();
+    const Lexeme& Current() const { return ring[ringHead]; }
+
+    void Lex(Lexeme& lexeme);
+    void SkipSpace();
+    void ParseStringLiteral(Lexeme& lexeme);
+    void ParseIntLiteral(Lexeme& lexeme);
+    void ParseKeywordIdentifier(Lexeme& lexeme);
+
+    static std::array<bool, 256> MakeSymbolTable(const std::string& chars);
+    static bool ClassifyKeyword(const std::string_view word, Keyword& keyword);
+    static bool MatchKeyword(const std::string_view word, const char* text,
+                             const Keyword candidate, Keyword& keyword);
 };
 
 #endif /* JACK_TOKENIZER_H */
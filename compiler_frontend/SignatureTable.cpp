@@ -0,0 +1,164 @@
+#include "SignatureTable.h"
+
+/* -------------------------------------------------------------------------- */
+
+SignatureTable::SignatureTable() : classes() {}
+
+/* -------------------------------------------------------------------------- */
+
+std::string SignatureTable::ScanFile(const std::string& fileName) {
+    std::string className;
+
+    try {
+        JackTokenizer jtok(fileName);
+
+        // 'class' className '{'
+        jtok.Advance();
+        if (!(jtok.TokenType() == JackTokenizer::KEYWORD &&
+              jtok.KeywordType() == JackTokenizer::CLASS)) {
+            return className;
+        }
+
+        jtok.Advance();
+        if (jtok.TokenType() != JackTokenizer::IDENTIFIER) return className;
+
+        className = jtok.GetToken();
+        auto& subroutines = classes[className];
+        jtok.Advance();
+        jtok.Advance();
+
+        // class variable declarations hold no braces, so the first '}' at
+        // this level closes the class
+        while (jtok.HasMoreTokens() && jtok.GetToken() != "}") {
+            const auto keyword = jtok.KeywordType();
+
+            if (jtok.TokenType() == JackTokenizer::KEYWORD &&
+                (keyword == JackTokenizer::CONSTRUCTOR ||
+                 keyword == JackTokenizer::FUNCTION ||
+                 keyword == JackTokenizer::METHOD)) {
+                ScanSubroutine(jtok, subroutines);
+            } else {
+                jtok.Advance();
+            }
+        }
+
+    } catch (const CompileError&) {
+        // reported when the file itself is compiled
+    }
+
+    return className;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void SignatureTable::AddClass(const std::string& className,
+                              const SubroutineMap& subroutines) {
+    classes[className] = subroutines;
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool SignatureTable::HasClass(const std::string_view className) const {
+    return classes.find(className) != classes.end();
+}
+
+/* -------------------------------------------------------------------------- */
+
+const SignatureTable::Signature* SignatureTable::Find(
+    const std::string_view className,
+    const std::string_view subroutineName) const {
+    const auto classIt = classes.find(className);
+    if (classIt == classes.end()) return nullptr;
+
+    const auto it = classIt->second.find(subroutineName);
+    if (it == classIt->second.end()) return nullptr;
+
+    return &it->second;
+}
+
+/* -------------------------------------------------------------------------- */
+
+std::string SignatureTable::Interface(const std::string_view className) const {
+    const auto classIt = classes.find(className);
+    if (classIt == classes.end()) return "";
+
+    std::string text = "class " + classIt->first + '\n';
+
+    for (const auto& entry : classIt->second) {
+        const auto& signature = entry.second;
+        text += std::to_string(static_cast<int>(signature.kind)) + ' ' +
+                entry.first + ' ' + std::to_string(signature.nArgs) + ' ' +
+                signature.returnType + '\n';
+    }
+
+    return text;
+}
+
+/* -------------------------------------------------------------------------- */
+
+const SignatureTable::SubroutineMap* SignatureTable::Subroutines(
+    const std::string_view className) const {
+    const auto classIt = classes.find(className);
+    return (classIt == classes.end()) ? nullptr : &classIt->second;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void SignatureTable::ScanSubroutine(JackTokenizer& jtok,
+                                    SubroutineMap& subroutines) {
+    // ('constructor' | 'function' | 'method') ('void' | type) subroutineName
+    // '(' parameterList ')' subroutineBody
+    Signature signature;
+    if (jtok.KeywordType() == JackTokenizer::CONSTRUCTOR) {
+        signature.kind = SubroutineDec::CONSTRUCTOR;
+    } else if (jtok.KeywordType() == JackTokenizer::FUNCTION) {
+        signature.kind = SubroutineDec::FUNCTION;
+    } else {
+        signature.kind = SubroutineDec::METHOD;
+    }
+
+    jtok.Advance();
+    signature.returnType = jtok.GetToken();
+
+    jtok.Advance();
+    const std::string name(jtok.GetToken());
+
+    jtok.Advance();
+    if (jtok.GetToken() != "(") return;
+
+    // one parameter per comma, plus one unless the list is empty
+    jtok.Advance();
+    signature.nArgs = (jtok.GetToken() == ")") ? 0 : 1;
+
+    while (jtok.HasMoreTokens() && jtok.GetToken() != ")") {
+        if (jtok.GetToken() == ",") ++signature.nArgs;
+        jtok.Advance();
+    }
+
+    jtok.Advance();
+    subroutines[name] = signature;
+
+    SkipBlock(jtok);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// advances past a '{' ... '}' block and everything nested in it
+void SignatureTable::SkipBlock(JackTokenizer& jtok) {
+    if (jtok.GetToken() != "{") return;
+
+    int depth = 0;
+    do {
+        if (jtok.TokenType() == JackTokenizer::SYMBOL) {
+            if (jtok.Symbol() == '{') {
+                ++depth;
+            } else if (jtok.Symbol() == '}') {
+                --depth;
+            }
+        }
+
+        jtok.Advance();
+    } while (depth > 0 && jtok.HasMoreTokens());
+}
+
+/* -------------------------------------------------------------------------- */
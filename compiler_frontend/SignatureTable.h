@@ -0,0 +1,69 @@
+#ifndef SIGNATURE_TABLE_H
+#define SIGNATURE_TABLE_H
+
+#include "Ast.h"
+#include "JackTokenizer.h"
+
+#include <map>
+#include <string>
+#include <string_view>
+
+// Kind, arity and return type of every subroutine declared by the classes
+// compiled together. Only class and subroutine headers are read, and all
+// files are scanned before any class is compiled, so a call can be checked
+// against a class that comes later in the batch. Classes outside the set
+// (the OS, unless it is compiled alongside) are unknown and their calls are
+// taken as written. The table is read-only once scanning is done, so compile
+// threads share it freely.
+class SignatureTable {
+  public:
+    SignatureTable();
+
+    // remove unwanted constructors
+    SignatureTable(const SignatureTable& that) = delete;
+    SignatureTable(const SignatureTable&& that) = delete;
+    SignatureTable& operator=(const SignatureTable& that) = delete;
+    SignatureTable& operator=(const SignatureTable&& that) = delete;
+
+    struct Signature {
+        SubroutineDec::Kind kind;
+        int nArgs;  // declared parameters, without the hidden "this"
+        std::string returnType;
+    };
+
+    using SubroutineMap = std::map<std::string, Signature, std::less<>>;
+
+    // returns the name of the class declared in the file, or an empty string
+    // if there is none. A file that fails to scan keeps whatever was read
+    // before the error, which compiling it will then report.
+    std::string ScanFile(const std::string& fileName);
+
+    // adds a class read earlier, e.g. from a build manifest
+    void AddClass(const std::string& className,
+                  const SubroutineMap& subroutines);
+
+    bool HasClass(const std::string_view className) const;
+
+    // nullptr if the class or the subroutine is unknown
+    const Signature* Find(const std::string_view className,
+                          const std::string_view subroutineName) const;
+
+    // every signature of the class in a fixed text form, empty if the class
+    // is unknown. Compiling another class can only be affected by this
+    // class's source through this text.
+    std::string Interface(const std::string_view className) const;
+
+    // nullptr if the class is unknown
+    const SubroutineMap* Subroutines(const std::string_view className) const;
+
+    // data
+  private:
+    std::map<std::string, SubroutineMap, std::less<>> classes;
+
+    // methods
+  private:
+    void ScanSubroutine(JackTokenizer& jtok, SubroutineMap& subroutines);
+    static void SkipBlock(JackTokenizer& jtok);
+};
+
+#endif /* SIGNATURE_TABLE_H */
@@ -1,7 +1,5 @@
 #include "SymbolTable.h"
-
-#include <cstdlib>
-#include <iostream>
+#include "ErrorHandler.h"
 
 /* -------------------------------------------------------------------------- */
 
@@ -11,28 +9,48 @@ SymbolTable::SymbolTable() :
         fieldVarCount(0),
         argVarCount(0),
         plainVarCount(0),
-        classTable(),
-        subroutineTable() {}
+        identifierIds(),
+        classSlots(),
+        classSymbols(),
+        subroutineSymbols() {}
 
 /* -------------------------------------------------------------------------- */
 
-void SymbolTable::StartSubroutine() {
-    subroutineTable.clear();
-    isMethod = false;
+// methods take "this" as a hidden first argument, so their declared
+// arguments start at index 1
+void SymbolTable::StartSubroutine(const bool method) {
+    subroutineSymbols.clear();
+    isMethod = method;
     argVarCount = 0;
     plainVarCount = 0;
 }
 
 /* -------------------------------------------------------------------------- */
 
-void SymbolTable::Define(const std::string& name, const std::string& type,
+int SymbolTable::Intern(const std::string_view name) {
+    auto it = identifierIds.find(name);
+    if (it == identifierIds.end()) {
+        const int id = static_cast<int>(identifierIds.size());
+        it = identifierIds.emplace(std::string(name), id).first;
+        classSlots.push_back(-1);
+    }
+
+    return it->second;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void SymbolTable::Define(const std::string_view name, const std::string& type,
                          const VARKIND kind) {
+    const int id = Intern(name);
+    const auto segment = kindToSegment.at(kind);
+
     if (kind == STATIC || kind == FIELD) {
         // class variable
-        if (classTable.find(name) != classTable.end()) {
-            std::cerr << "ERROR: class variable " << name
-                      << " already defined in this scope\n";
-            std::exit(1);
+        if (classSlots[static_cast<size_t>(id)] >= 0) {
+            throw CompileError("ERROR: class variable " + std::string(name) +
+                                   " already defined in this scope",
+                               1);
         }
 
         int index = -1;
@@ -44,27 +62,28 @@ void SymbolTable::Define(const std::string& name, const std::string& type,
             ++fieldVarCount;
         }
 
-        VarData data(type, kind, index);
-        classTable.insert({name, data});
+        classSlots[static_cast<size_t>(id)] =
+            static_cast<int>(classSymbols.size());
+        classSymbols.emplace_back(type, kind, segment, index);
     } else {
         // subroutine variable
-        if (subroutineTable.find(name) != subroutineTable.end()) {
-            std::cerr << "ERROR: subroutine variable " << name
-                      << " already defined in this scope\n";
-            std::exit(1);
+        if (FindSubroutineSymbol(id)) {
+            throw CompileError("ERROR: subroutine variable " +
+                                   std::string(name) +
+                                   " already defined in this scope",
+                               1);
         }
 
         int index = -1;
         if (kind == ARG) {
-            index = argVarCount;
+            index = isMethod ? argVarCount + 1 : argVarCount;
             ++argVarCount;
         } else {
             index = plainVarCount;
             ++plainVarCount;
         }
 
-        VarData data(type, kind, index);
-        subroutineTable.insert({name, data});
+        subroutineSymbols.emplace_back(id, Symbol(type, kind, segment, index));
     }
 }
 
@@ -88,68 +107,38 @@ int SymbolTable::VarCount(const VARKIND kind) const {
 
 /* -------------------------------------------------------------------------- */
 
-SymbolTable::VARKIND SymbolTable::KindOf(const std::string& name) const {
-    VarData data = GetVarData(name);
-
-    return data.kind;
-}
-
-/* -------------------------------------------------------------------------- */
-
-std::string SymbolTable::TypeOf(const std::string& name) const {
-    VarData data = GetVarData(name);
-
-    return data.type;
-}
-
-/* -------------------------------------------------------------------------- */
-
-int SymbolTable::IndexOf(const std::string& name) const {
-    VarData data = GetVarData(name);
-
-    auto result =
-        (isMethod && data.kind == ARG) ? (data.index + 1) : data.index;
-    return result;
-}
-
-/* -------------------------------------------------------------------------- */
+// subroutine variables shadow class variables of the same name
+const SymbolTable::Symbol* SymbolTable::Find(
+    const std::string_view name) const {
+    const auto it = identifierIds.find(name);
+    if (it == identifierIds.end()) {
+        return nullptr;
+    }
 
-// non-erroring check for identifier
-bool SymbolTable::Check(const std::string& identifier) const {
-    bool isPresent = false;
+    const int id = it->second;
+    if (const Symbol* local = FindSubroutineSymbol(id)) {
+        return local;
+    }
 
-    if (classTable.find(identifier) != classTable.end() ||
-        subroutineTable.find(identifier) != subroutineTable.end()) {
-        isPresent = true;
+    const int slot = classSlots[static_cast<size_t>(id)];
+    if (slot < 0) {
+        return nullptr;
     }
 
-    return isPresent;
+    return &classSymbols[static_cast<size_t>(slot)];
 }
 
 /* -------------------------------------------------------------------------- */
 
-SymbolTable::VarData SymbolTable::GetVarData(const std::string& name) const {
-    VarData data;
-
-    if (classTable.find(name) != classTable.end()) {
-        data = classTable.at(name);
-    } else if (subroutineTable.find(name) != subroutineTable.end()) {
-        data = subroutineTable.at(name);
-    } else {
-        ReportMissingVar(name);
+const SymbolTable::Symbol* SymbolTable::FindSubroutineSymbol(
+    const int id) const {
+    for (const auto& entry : subroutineSymbols) {
+        if (entry.first == id) {
+            return &entry.second;
+        }
     }
 
-    return data;
-}
-
-/* -------------------------------------------------------------------------- */
-
-// NOTE: probably better to include a line number or roll into existing
-//       error reporting, but going for simplicity at present
-void SymbolTable::ReportMissingVar(const std::string& name) const {
-    std::cerr << "ERROR: Variable " << name
-              << " not defined in current scope\n";
-    std::exit(1);
+    return nullptr;
 }
 
 /* -------------------------------------------------------------------------- */
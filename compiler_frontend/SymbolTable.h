@@ -1,9 +1,18 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
+#include "VMWriter.h"
+
 #include <map>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+// Identifiers are interned to small integer IDs the first time they are seen.
+// Class scope is a flat vector indexed by ID and subroutine scope is a short
+// list searched in declaration order, so resolving a variable is one name
+// lookup followed by integer compares.
 class SymbolTable {
   public:
     SymbolTable();
@@ -16,28 +25,29 @@ class SymbolTable {
 
     enum VARKIND { STATIC, FIELD, ARG, VAR };
 
-    struct VarData {
+    struct Symbol {
         std::string type;
         VARKIND kind;
-        int index;
+        VMWriter::Segment segment;
+        int index;  // already offset for the hidden "this" argument
 
-        VarData() : type(), kind(), index(-1) {}
-        VarData(const std::string& t, const VARKIND k, const int i) :
+        Symbol(const std::string& t, const VARKIND k,
+               const VMWriter::Segment s, const int i) :
                 type(t),
                 kind(k),
+                segment(s),
                 index(i) {}
     };
 
-    void StartSubroutine();
+    void StartSubroutine(const bool method);
 
-    void Define(const std::string& name, const std::string& type,
+    void Define(const std::string_view name, const std::string& type,
                 const VARKIND kind);
     int VarCount(const VARKIND kind) const;
-    VARKIND KindOf(const std::string& name) const;
-    std::string TypeOf(const std::string& name) const;
-    int IndexOf(const std::string& name) const;
-    bool Check(const std::string& name) const;
-    void SetMethod() { isMethod = true; }
+
+    // nullptr if the name is not defined in either scope, otherwise valid
+    // until the next Define
+    const Symbol* Find(const std::string_view name) const;
 
     // data
   private:
@@ -47,13 +57,24 @@ class SymbolTable {
     int argVarCount;
     int plainVarCount;
 
-    std::map<std::string, VarData> classTable;
-    std::map<std::string, VarData> subroutineTable;
+    std::map<std::string, int, std::less<>> identifierIds;
+
+    // class scope: slot in classSymbols for each identifier ID, or -1
+    std::vector<int> classSlots;
+    std::vector<Symbol> classSymbols;
+
+    std::vector<std::pair<int, Symbol>> subroutineSymbols;
+
+    const std::map<VARKIND, VMWriter::Segment> kindToSegment = {
+        {VAR, VMWriter::LOCAL},
+        {ARG, VMWriter::ARG},
+        {FIELD, VMWriter::THIS},
+        {STATIC, VMWriter::STATIC}};
 
     // methods
   private:
-    VarData GetVarData(const std::string& name) const;
-    void ReportMissingVar(const std::string& name) const;
+    int Intern(const std::string_view name);
+    const Symbol* FindSubroutineSymbol(const int id) const;
 };
 
 #endif /* SYMBOL_TABLE_H */
@@ -4,7 +4,13 @@
 
 /* -------------------------------------------------------------------------- */
 
-VMWriter::VMWriter(std::ofstream& out) : outFile(out) {
+VMWriter::VMWriter(std::ofstream& out, const Format fmt) :
+        outFile(out),
+        format(fmt),
+        sink(nullptr),
+        code(),
+        strings(),
+        stringIds() {
     /*
         if (!outFile.is_open()) {
             std::cerr << "ERROR: Could not open file \"" << outName << "\"\n";
@@ -16,53 +22,220 @@ VMWriter::VMWriter(std::ofstream& out) : outFile(out) {
 /* -------------------------------------------------------------------------- */
 
 void VMWriter::WritePush(const Segment segment, const int index) {
+    if (sink) {
+        sink->Write(vmb::PUSH, binarySegments.at(segment), index, "");
+        return;
+
+    } else if (format == BINARY) {
+        EmitByte(vmb::PUSH);
+        EmitByte(binarySegments.at(segment));
+        EmitVarint(code, static_cast<unsigned>(index));
+        return;
+    }
+
     outFile << "push " << segNames.at(segment) << ' ' << index << '\n';
 }
 
 /* -------------------------------------------------------------------------- */
 
 void VMWriter::WritePop(const Segment segment, const int index) {
+    if (sink) {
+        sink->Write(vmb::POP, binarySegments.at(segment), index, "");
+        return;
+
+    } else if (format == BINARY) {
+        EmitByte(vmb::POP);
+        EmitByte(binarySegments.at(segment));
+        EmitVarint(code, static_cast<unsigned>(index));
+        return;
+    }
+
     outFile << "pop " << segNames.at(segment) << ' ' << index << '\n';
 }
 
 /* -------------------------------------------------------------------------- */
 
 void VMWriter::WriteArithmetic(const Command command) {
+    if ((sink || format == BINARY) && command == MULT) {
+        WriteCall("Math.multiply", 2);
+        return;
+
+    } else if ((sink || format == BINARY) && command == DIV) {
+        WriteCall("Math.divide", 2);
+        return;
+
+    } else if (sink) {
+        sink->Write(binaryOpcodes.at(command), vmb::CONSTANT, 0, "");
+        return;
+
+    } else if (format == BINARY) {
+        EmitByte(binaryOpcodes.at(command));
+        return;
+    }
+
     outFile << commandNames.at(command) << '\n';
 }
 
 /* -------------------------------------------------------------------------- */
 
 void VMWriter::WriteLabel(const std::string& label) {
+    if (sink) {
+        sink->Write(vmb::LABEL, vmb::CONSTANT, 0, label);
+        return;
+
+    } else if (format == BINARY) {
+        EmitName(vmb::LABEL, label);
+        return;
+    }
+
     outFile << "label " << label << '\n';
 }
 
 /* -------------------------------------------------------------------------- */
 
 void VMWriter::WriteGoto(const std::string& label) {
+    if (sink) {
+        sink->Write(vmb::GOTO, vmb::CONSTANT, 0, label);
+        return;
+
+    } else if (format == BINARY) {
+        EmitName(vmb::GOTO, label);
+        return;
+    }
+
     outFile << "goto " << label << '\n';
 }
 
 /* -------------------------------------------------------------------------- */
 
 void VMWriter::WriteIf(const std::string& label) {
+    if (sink) {
+        sink->Write(vmb::IF_GOTO, vmb::CONSTANT, 0, label);
+        return;
+
+    } else if (format == BINARY) {
+        EmitName(vmb::IF_GOTO, label);
+        return;
+    }
+
     outFile << "if-goto " << label << '\n';
 }
 
 /* -------------------------------------------------------------------------- */
 
 void VMWriter::WriteCall(const std::string& name, const int nArgs) {
+    if (sink) {
+        sink->Write(vmb::CALL, vmb::CONSTANT, nArgs, name);
+        return;
+
+    } else if (format == BINARY) {
+        EmitName(vmb::CALL, name);
+        EmitVarint(code, static_cast<unsigned>(nArgs));
+        return;
+    }
+
     outFile << "call " << name << ' ' << nArgs << '\n';
 }
 
 /* -------------------------------------------------------------------------- */
 
 void VMWriter::WriteFunction(const std::string& name, const int nLocals) {
+    if (sink) {
+        sink->Write(vmb::FUNCTION, vmb::CONSTANT, nLocals, name);
+        return;
+
+    } else if (format == BINARY) {
+        EmitName(vmb::FUNCTION, name);
+        EmitVarint(code, static_cast<unsigned>(nLocals));
+        return;
+    }
+
     outFile << "function " << name << ' ' << nLocals << '\n';
 }
 
 /* -------------------------------------------------------------------------- */
 
-void VMWriter::WriteReturn() { outFile << "return\n"; }
+void VMWriter::WriteReturn() {
+    if (sink) {
+        sink->Write(vmb::RETURN, vmb::CONSTANT, 0, "");
+        return;
+
+    } else if (format == BINARY) {
+        EmitByte(vmb::RETURN);
+        return;
+    }
+
+    outFile << "return\n";
+}
+
+/* -------------------------------------------------------------------------- */
+
+void VMWriter::WritePreserves(const bool keepThis, const bool keepThat) {
+    if (!keepThis && !keepThat) return;
+
+    uint8_t flags = 0;
+    if (keepThis) flags |= vmb::PRESERVE_THIS;
+    if (keepThat) flags |= vmb::PRESERVE_THAT;
+
+    if (sink) {
+        sink->Write(vmb::PRESERVES, vmb::CONSTANT, flags, "");
+        return;
+
+    } else if (format == BINARY) {
+        EmitByte(vmb::PRESERVES);
+        EmitByte(flags);
+        return;
+    }
+
+    // text tools outside this toolchain do not know the command
+    outFile << "// preserves" << (keepThis ? " this" : "")
+            << (keepThat ? " that" : "") << '\n';
+}
+
+/* -------------------------------------------------------------------------- */
+
+void VMWriter::Close() {
+    if (format != BINARY) return;
+
+    std::string header(vmb::magic, vmb::magicSize);
+
+    EmitVarint(header, static_cast<unsigned>(strings.size()));
+
+    for (const auto& name : strings) {
+        EmitVarint(header, static_cast<unsigned>(name.size()));
+        header += name;
+    }
+
+    outFile << header << code;
+    code.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+
+// unsigned LEB128
+void VMWriter::EmitVarint(std::string& buffer, unsigned value) {
+    while (value >= 0x80) {
+        buffer += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+
+    buffer += static_cast<char>(value);
+}
+
+/* -------------------------------------------------------------------------- */
+
+// opcode followed by the string table id of name, adding it if new
+void VMWriter::EmitName(const vmb::Opcode opcode, const std::string& name) {
+    auto entry = stringIds.find(name);
+
+    if (entry == stringIds.end()) {
+        const auto id = static_cast<unsigned>(strings.size());
+        entry = stringIds.emplace(name, id).first;
+        strings.push_back(name);
+    }
+
+    EmitByte(opcode);
+    EmitVarint(code, entry->second);
+}
 
 /* -------------------------------------------------------------------------- */
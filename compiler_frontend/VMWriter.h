@@ -1,13 +1,29 @@
 #ifndef VM_WRITER_H
 #define VM_WRITER_H
 
+#include "../compiler_backend/vm_binary.h"
+
 #include <fstream>
 #include <map>
 #include <string>
+#include <vector>
+
+// receives VM commands in place of an output file, used by the pipelined
+// driver to hand commands straight to the VM translator
+class VMSink {
+  public:
+    virtual ~VMSink() = default;
+
+    // name is the function or label name where the opcode takes one
+    virtual void Write(const vmb::Opcode opcode, const vmb::Segment segment,
+                       const int value, const std::string& name) = 0;
+};
 
 class VMWriter {
   public:
-    VMWriter(std::ofstream& out);
+    enum Format { TEXT, BINARY };
+
+    VMWriter(std::ofstream& out, const Format fmt = TEXT);
 
     // remove unwanted constructors
     VMWriter(const VMWriter& that) = delete;
@@ -49,9 +65,40 @@ class VMWriter {
 
     void WriteReturn();
 
+    // announces which of pointer 0 and 1 the next function leaves alone
+    void WritePreserves(const bool keepThis, const bool keepThat);
+
+    // writes out buffered binary output, no-op for text
+    void Close();
+
+    // send all further commands to sink instead of the output file
+    void SetSink(VMSink* vmSink) { sink = vmSink; }
+
     // data
   private:
     std::ofstream& outFile;
+    Format format;
+    VMSink* sink;
+
+    // binary output is buffered until Close() so the string table can
+    // precede the code
+    std::string code;
+    std::vector<std::string> strings;
+    std::map<std::string, unsigned> stringIds;
+
+    const std::map<Segment, vmb::Segment> binarySegments = {
+        {CONST, vmb::CONSTANT}, {ARG, vmb::ARGUMENT}, {LOCAL, vmb::LOCAL},
+        {STATIC, vmb::STATIC},  {THIS, vmb::THIS},    {THAT, vmb::THAT},
+        {POINTER, vmb::POINTER}, {TEMP, vmb::TEMP}};
+
+    const std::map<Command, vmb::Opcode> binaryOpcodes = {
+        {ADD, vmb::ADD}, {SUB, vmb::SUB}, {NEG, vmb::NEG}, {EQ, vmb::EQ},
+        {GT, vmb::GT},   {LT, vmb::LT},   {AND, vmb::AND}, {OR, vmb::OR},
+        {NOT, vmb::NOT}};
+
+    void EmitByte(const uint8_t byte) { code += static_cast<char>(byte); }
+    void EmitVarint(std::string& buffer, unsigned value);
+    void EmitName(const vmb::Opcode opcode, const std::string& name);
 };
 
 #endif /* VM_WRITER_H */
@@ -1,44 +1,116 @@
+#include "BuildManifest.h"
 #include "CompilationEngine.h"
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
 
 namespace fs = std::filesystem;
 
 const std::string inExt = ".jack";
-const std::string outExt = ".vm";
+const std::string textExt = ".vm";
+const std::string binaryExt = ".vmb";
+const std::string manifestName = ".jack-manifest";
+
+// options
+const std::string binaryFlag = "--binary";
+const std::string jobsFlag = "-j";
+const std::string noIntrinsicsFlag = "--no-intrinsics";
+const std::string incrementalFlag = "--incremental";
+
+// settings shared by every file of a run
+struct CompileOptions {
+    VMWriter::Format format;
+    bool intrinsics;
+    bool incremental;
+};
+
+// outcome of compiling one file, status 0 on success
+struct CompileResult {
+    int status;
+    std::string log;
+    std::set<std::string> dependencies;  // classes whose signatures were used
+};
+
+CompileResult CompileFile(const std::string& inName, const std::string& outName,
+                          const SignatureTable& signatures,
+                          const CompileOptions& options);
+int CompileBatch(const std::vector<fs::path>& sources,
+                 const std::string& outExt, const CompileOptions& options,
+                 const unsigned jobs, const fs::path& manifestPath);
+std::string OptionsKey(const CompileOptions& options);
+void PrintUsage(const std::string& progName);
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <.jack file or directory>\n";
-        std::exit(EXIT_FAILURE);
+    std::string inputName = "";
+    CompileOptions options = {VMWriter::TEXT, true, false};
+    unsigned jobs = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == binaryFlag) {
+            options.format = VMWriter::BINARY;
+        } else if (arg == noIntrinsicsFlag) {
+            options.intrinsics = false;
+        } else if (arg == incrementalFlag) {
+            options.incremental = true;
+        } else if (arg == jobsFlag && i + 1 < argc) {
+            const std::string count = argv[++i];
+            if (count.empty() ||
+                count.find_first_not_of("0123456789") != std::string::npos ||
+                std::stoul(count) == 0) {
+                PrintUsage(argv[0]);
+            }
+
+            jobs = static_cast<unsigned>(std::stoul(count));
+        } else if (inputName.empty()) {
+            inputName = arg;
+        } else {
+            PrintUsage(argv[0]);
+        }
     }
 
-    fs::path inputPath(argv[1]);
+    if (inputName.empty()) PrintUsage(argv[0]);
+
+    fs::path inputPath(inputName);
     std::string outName = "";
+    const std::string outExt =
+        (options.format == VMWriter::BINARY) ? binaryExt : textExt;
 
     if (fs::exists(inputPath)) {
         if (fs::is_regular_file(inputPath) && inputPath.extension() == inExt) {
             outName = inputPath.stem();
             outName += outExt;
 
-            CompilationEngine compiler(inputPath.filename(), outName);
+            SignatureTable signatures;
+            signatures.ScanFile(inputPath.filename());
 
-            compiler.CompileClass();
+            const auto result = CompileFile(inputPath.filename(), outName,
+                                            signatures, options);
+            if (result.status != 0) {
+                std::cerr << result.log << '\n';
+                return result.status;
+            }
 
         } else if (fs::is_directory(inputPath)) {
+            std::vector<fs::path> sources;
             for (auto& p : fs::directory_iterator(inputPath)) {
-                auto path = p.path();
-                if (path.extension() == inExt) {
-                    fs::path currFilePath = path.parent_path() / path.stem();
-                    outName = currFilePath.string() + outExt;
-
-                    CompilationEngine compiler(path.string(), outName);
-
-                    compiler.CompileClass();
+                if (p.path().extension() == inExt) {
+                    sources.push_back(p.path());
                 }
             }
 
+            // sorted so that logs come out in the same order on every run
+            std::sort(sources.begin(), sources.end());
+
+            return CompileBatch(sources, outExt, options, jobs,
+                                inputPath / manifestName);
+
         } else {
             std::cerr << "ERROR: Unsupported file type for " << inputPath
                       << '\n';
@@ -50,3 +122,168 @@ int main(int argc, char* argv[]) {
 
     return 0;
 }
+
+/* -------------------------------------------------------------------------- */
+
+// compiles one class; a file that fails to compile leaves no output behind
+CompileResult CompileFile(const std::string& inName, const std::string& outName,
+                          const SignatureTable& signatures,
+                          const CompileOptions& options) {
+    try {
+        CompilationEngine compiler(inName, outName, signatures,
+                                   options.format);
+
+        compiler.SetIntrinsics(options.intrinsics);
+        compiler.CompileClass();
+
+        return {0, "", compiler.ReferencedClasses()};
+
+    } catch (const CompileError& err) {
+        std::error_code ignored;
+        fs::remove(outName, ignored);
+
+        return {err.Status(), err.what(), {}};
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// compiles every file in sources on up to jobs threads. The subroutine
+// signatures of the whole batch are read first; after that files are
+// independent, so a failed file is recorded and the rest still compiles.
+// Errors are printed in source order once all files are done, and the status
+// of the first failed file is returned.
+//
+// An incremental build skips the files that the manifest shows to be up to
+// date and still have their output, then records the files it compiled.
+int CompileBatch(const std::vector<fs::path>& sources,
+                 const std::string& outExt, const CompileOptions& options,
+                 const unsigned jobs, const fs::path& manifestPath) {
+    BuildManifest manifest(manifestPath.string(), OptionsKey(options));
+    std::vector<uint64_t> sourceHashes(sources.size());
+    std::vector<std::string> classNames(sources.size());
+
+    if (options.incremental) manifest.Load();
+
+    // the signatures of a file unchanged since the last incremental build
+    // are read back from the manifest instead
+    SignatureTable signatures;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const auto& path = sources[i];
+
+        if (options.incremental) {
+            sourceHashes[i] = BuildManifest::HashFile(path.string());
+            classNames[i] = manifest.Restore(path.filename().string(),
+                                             sourceHashes[i], signatures);
+        }
+
+        if (classNames[i].empty()) {
+            classNames[i] = signatures.ScanFile(path.string());
+        }
+    }
+
+    auto outNameOf = [&](const fs::path& path) {
+        fs::path currFilePath = path.parent_path() / path.stem();
+        return currFilePath.string() + outExt;
+    };
+
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const auto& path = sources[i];
+
+        if (options.incremental && fs::exists(outNameOf(path)) &&
+            manifest.UpToDate(path.filename().string(), sourceHashes[i],
+                              signatures)) {
+            continue;
+        }
+
+        pending.push_back(i);
+    }
+
+    std::vector<CompileResult> results(sources.size());
+    std::atomic<size_t> nextSource(0);
+
+    auto worker = [&]() {
+        for (size_t p = nextSource++; p < pending.size(); p = nextSource++) {
+            const auto& path = sources[pending[p]];
+
+            results[pending[p]] = CompileFile(path.string(), outNameOf(path),
+                                              signatures, options);
+        }
+    };
+
+    const size_t nThreads = std::min<size_t>(jobs, pending.size());
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < nThreads; ++i) {
+        pool.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    int status = 0;
+    for (const auto& result : results) {
+        if (result.status != 0) {
+            std::cerr << result.log << '\n';
+
+            if (status == 0) status = result.status;
+        }
+    }
+
+    if (options.incremental) {
+        std::set<std::string> names;
+        for (const auto& path : sources) {
+            names.insert(path.filename().string());
+        }
+
+        for (const auto i : pending) {
+            const std::string name = sources[i].filename().string();
+
+            if (results[i].status == 0) {
+                manifest.Record(name, sourceHashes[i], classNames[i],
+                                results[i].dependencies, signatures);
+            } else {
+                manifest.Forget(name);
+            }
+        }
+
+        manifest.Prune(names);
+        manifest.Save();
+    }
+
+    return status;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// the compiler settings that change the output of a file
+std::string OptionsKey(const CompileOptions& options) {
+    std::string key =
+        (options.format == VMWriter::BINARY) ? binaryExt : textExt;
+
+    if (!options.intrinsics) key += ' ' + noIntrinsicsFlag;
+
+    return key;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void PrintUsage(const std::string& progName) {
+    std::cerr << "Usage: " << progName << " <.jack file or directory> ["
+              << binaryFlag << "] [" << jobsFlag << " N] ["
+              << noIntrinsicsFlag << "] [" << incrementalFlag << "]\n";
+    std::cerr << "  " << binaryFlag
+              << "  write binary .vmb files instead of text .vm\n";
+    std::cerr << "  " << jobsFlag
+              << " N    compile the files of a directory on N threads\n";
+    std::cerr << "  " << noIntrinsicsFlag
+              << "  always call Memory.peek/poke and Array.new/dispose\n";
+    std::cerr << "  " << incrementalFlag
+              << "    only recompile the files of a directory whose source,\n"
+              << "                   or the subroutines they call, changed\n";
+    std::exit(EXIT_FAILURE);
+}
@@ -0,0 +1,64 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed-capacity ring buffer for exactly one producer thread and one consumer
+// thread. The indices are the only shared state, so no locks are needed; a
+// full (or empty) queue makes the producer (or consumer) yield until the
+// other side catches up.
+template <typename T>
+class BoundedQueue {
+  public:
+    explicit BoundedQueue(const size_t capacity) :
+            slots(capacity + 1),
+            head(0),
+            tail(0) {}
+
+    // remove unwanted constructors
+    BoundedQueue(const BoundedQueue& that) = delete;
+    BoundedQueue(const BoundedQueue&& that) = delete;
+    BoundedQueue& operator=(const BoundedQueue& that) = delete;
+    BoundedQueue& operator=(const BoundedQueue&& that) = delete;
+
+    void Push(T item) {
+        const size_t pos = tail.load(std::memory_order_relaxed);
+        const size_t next = Next(pos);
+
+        while (next == head.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        slots[pos] = std::move(item);
+        tail.store(next, std::memory_order_release);
+    }
+
+    T Pop() {
+        const size_t pos = head.load(std::memory_order_relaxed);
+
+        while (pos == tail.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        T item = std::move(slots[pos]);
+        head.store(Next(pos), std::memory_order_release);
+
+        return item;
+    }
+
+  private:
+    // one slot stays empty to tell a full queue from an empty one
+    std::vector<T> slots;
+
+    // kept on separate cache lines so the two threads don't contend
+    alignas(64) std::atomic<size_t> head;  // next slot to read (consumer)
+    alignas(64) std::atomic<size_t> tail;  // next slot to write (producer)
+
+    size_t Next(const size_t pos) const { return (pos + 1) % slots.size(); }
+};
+
+#endif /* BOUNDED_QUEUE_H */
@@ -0,0 +1,169 @@
+#include "stages.h"
+
+#include "CompilationEngine.h"
+#include "asm_writer.h"
+#include "hack_assembler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+const std::string inExt = ".jack";
+const std::string asmExt = ".asm";
+const std::string hackExt = ".hack";
+
+// options
+const std::string noInlineMathFlag = "--no-inline-math";
+const std::string noIntrinsicsFlag = "--no-intrinsics";
+const std::string hackFlag = "--hack";
+
+// queue capacities bound the memory held between stages
+const size_t vmQueueSize = 1024;
+const size_t hackQueueSize = 4096;
+
+void PrintUsage(const std::string& progName);
+
+// Compiles Jack classes straight to Hack code without intermediate files.
+// The Jack compiler runs on the main thread, the VM translator and the
+// assembler each run on their own thread, connected by bounded queues.
+int main(int argc, char* argv[]) {
+    std::string inputName = "";
+    bool inlineMath = true;
+    bool intrinsics = true;
+    bool hackOutput = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == noInlineMathFlag) {
+            inlineMath = false;
+        } else if (arg == noIntrinsicsFlag) {
+            intrinsics = false;
+        } else if (arg == hackFlag) {
+            hackOutput = true;
+        } else if (inputName.empty()) {
+            inputName = arg;
+        } else {
+            PrintUsage(argv[0]);
+        }
+    }
+
+    if (inputName.empty()) PrintUsage(argv[0]);
+
+    fs::path inputPath(inputName);
+    std::vector<fs::path> sources;
+
+    if (!fs::exists(inputPath)) {
+        std::cerr << inputPath << " does not exist\n";
+        return 0;
+
+    } else if (fs::is_regular_file(inputPath) &&
+               inputPath.extension() == inExt) {
+        sources.push_back(inputPath);
+
+    } else if (fs::is_directory(inputPath)) {
+        // trailing separator leaves an empty file name
+        if (inputPath.filename().empty()) inputPath = inputPath.parent_path();
+
+        for (auto& p : fs::directory_iterator(inputPath)) {
+            if (p.path().extension() == inExt) sources.push_back(p.path());
+        }
+
+        // sorted so that the program layout does not depend on the order
+        // the file system lists the directory in
+        std::sort(sources.begin(), sources.end());
+
+    } else {
+        std::cerr << "ERROR: Unsupported file type for " << inputPath << '\n';
+        return 0;
+    }
+
+    // Foo.jack -> Foo.asm, dir -> dir/dir.asm
+    fs::path outPath = fs::is_directory(inputPath)
+                           ? inputPath / inputPath.filename()
+                           : inputPath.parent_path() / inputPath.stem();
+    outPath += hackOutput ? hackExt : asmExt;
+
+    std::unique_ptr<InstructionSink> output;
+    if (hackOutput) {
+        output = std::make_unique<HackAssembler>(outPath.string());
+    } else {
+        output = std::make_unique<AsmWriter>(outPath.string());
+    }
+
+    VMQueue vmQueue(vmQueueSize);
+    HackQueue hackQueue(hackQueueSize);
+
+    CodeWriter writer(std::make_unique<HackQueueSink>(hackQueue));
+    writer.SetInlineMath(inlineMath);
+
+    std::thread assembler(AssembleStage, std::ref(hackQueue),
+                          std::ref(*output));
+    std::thread translator(TranslateStage, std::ref(vmQueue),
+                           std::ref(writer));
+
+    VMQueueSink vmSink(vmQueue);
+
+    SignatureTable signatures;
+    for (const auto& source : sources) {
+        signatures.ScanFile(source.string());
+    }
+
+    bool failed = false;
+    int status = 0;
+
+    for (const auto& source : sources) {
+        vmSink.StartFile(source.stem());
+
+        try {
+            CompilationEngine compiler(source.string(), vmSink, signatures);
+            compiler.SetIntrinsics(intrinsics);
+            compiler.CompileClass();
+
+        } catch (const CompileError& err) {
+            std::cerr << err.what() << '\n';
+            failed = true;
+            status = err.Status();
+            break;
+        }
+    }
+
+    // the later stages are mid-stream after an error, so they are still
+    // shut down in order before the partial output is removed
+    vmSink.Finish();
+
+    translator.join();
+    assembler.join();
+
+    if (failed) {
+        output.reset();
+
+        std::error_code ignored;
+        fs::remove(outPath, ignored);
+    }
+
+    return status;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void PrintUsage(const std::string& progName) {
+    std::cerr << "Usage: " << progName << " <.jack file or directory> ["
+              << hackFlag << "] [" << noInlineMathFlag << "] ["
+              << noIntrinsicsFlag << "]\n";
+    std::cerr << "  " << hackFlag
+              << "            write machine code instead of assembly\n";
+    std::cerr << "  " << noInlineMathFlag
+              << "  always call Math.multiply and Math.divide\n";
+    std::cerr << "  " << noIntrinsicsFlag
+              << "   always call Memory.peek/poke and Array.new/dispose\n";
+    std::exit(EXIT_FAILURE);
+}
+
+/* -------------------------------------------------------------------------- */
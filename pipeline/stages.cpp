@@ -0,0 +1,168 @@
+#include "stages.h"
+
+#include <iostream>
+#include <map>
+
+const std::map<vmb::Opcode, std::string> arithmeticNames = {
+    {vmb::ADD, "add"}, {vmb::SUB, "sub"}, {vmb::NEG, "neg"},
+    {vmb::EQ, "eq"},   {vmb::GT, "gt"},   {vmb::LT, "lt"},
+    {vmb::AND, "and"}, {vmb::OR, "or"},   {vmb::NOT, "not"}};
+
+/* -------------------------------------------------------------------------- */
+
+VMQueueSink::VMQueueSink(VMQueue& queue) : vmQueue(queue) {}
+
+/* -------------------------------------------------------------------------- */
+
+void VMQueueSink::StartFile(const std::string& stem) {
+    VMItem item;
+    item.kind = VMItem::FILE;
+    item.name = stem;
+
+    vmQueue.Push(std::move(item));
+}
+
+/* -------------------------------------------------------------------------- */
+
+void VMQueueSink::Write(const vmb::Opcode opcode, const vmb::Segment segment,
+                        const int value, const std::string& name) {
+    VMItem item;
+    item.kind = VMItem::COMMAND;
+    item.opcode = opcode;
+    item.segment = segment;
+    item.value = value;
+    item.name = name;
+
+    vmQueue.Push(std::move(item));
+}
+
+/* -------------------------------------------------------------------------- */
+
+void VMQueueSink::Finish() { vmQueue.Push(VMItem()); }
+
+/* -------------------------------------------------------------------------- */
+
+HackQueueSink::HackQueueSink(HackQueue& queue) : hackQueue(queue) {}
+
+/* -------------------------------------------------------------------------- */
+
+void HackQueueSink::Address(const int value) {
+    HackItem item;
+    item.kind = HackItem::ADDRESS;
+    item.value = value;
+
+    hackQueue.Push(std::move(item));
+}
+
+/* -------------------------------------------------------------------------- */
+
+void HackQueueSink::Address(const std::string& symbol) {
+    HackItem item;
+    item.kind = HackItem::SYMBOL;
+    item.symbol = symbol;
+
+    hackQueue.Push(std::move(item));
+}
+
+/* -------------------------------------------------------------------------- */
+
+void HackQueueSink::Compute(const uint16_t code) {
+    HackItem item;
+    item.kind = HackItem::COMPUTE;
+    item.value = code;
+
+    hackQueue.Push(std::move(item));
+}
+
+/* -------------------------------------------------------------------------- */
+
+void HackQueueSink::Label(const std::string& symbol) {
+    HackItem item;
+    item.kind = HackItem::LABEL;
+    item.symbol = symbol;
+
+    hackQueue.Push(std::move(item));
+}
+
+/* -------------------------------------------------------------------------- */
+
+void HackQueueSink::Finish() { hackQueue.Push(HackItem()); }
+
+/* -------------------------------------------------------------------------- */
+
+// same dispatch as the VM translator's TranslateVMFile, on decoded commands
+void TranslateStage(VMQueue& in, CodeWriter& writer) {
+    writer.WriteInit();
+
+    for (VMItem item = in.Pop(); item.kind != VMItem::END; item = in.Pop()) {
+        if (item.kind == VMItem::FILE) {
+            writer.SetFileName(item.name);
+            continue;
+        }
+
+        const auto arithmetic = arithmeticNames.find(item.opcode);
+
+        if (arithmetic != arithmeticNames.end()) {
+            writer.WriteArithmetic(arithmetic->second);
+
+        } else if (item.opcode == vmb::PUSH) {
+            writer.WritePushPop(Command::PUSH, vmb::segmentNames[item.segment],
+                                item.value);
+
+        } else if (item.opcode == vmb::POP) {
+            writer.WritePushPop(Command::POP, vmb::segmentNames[item.segment],
+                                item.value);
+
+        } else if (item.opcode == vmb::LABEL) {
+            writer.WriteLabel(item.name);
+
+        } else if (item.opcode == vmb::GOTO) {
+            writer.WriteGoto(item.name);
+
+        } else if (item.opcode == vmb::IF_GOTO) {
+            writer.WriteIf(item.name);
+
+        } else if (item.opcode == vmb::FUNCTION) {
+            writer.WriteFunction(item.name, item.value);
+
+        } else if (item.opcode == vmb::CALL) {
+            writer.WriteCall(item.name, item.value);
+
+        } else if (item.opcode == vmb::RETURN) {
+            writer.WriteReturn();
+
+        } else if (item.opcode == vmb::PRESERVES) {
+            writer.WritePreserves(static_cast<uint8_t>(item.value));
+
+        } else {
+            std::cerr << "WARNING: Unsupported command type\n";
+        }
+    }
+
+    // flushes the shared routines and passes END on to the assembler
+    writer.Close();
+}
+
+/* -------------------------------------------------------------------------- */
+
+void AssembleStage(HackQueue& in, InstructionSink& out) {
+    for (HackItem item = in.Pop(); item.kind != HackItem::END;
+         item = in.Pop()) {
+        if (item.kind == HackItem::ADDRESS) {
+            out.Address(item.value);
+
+        } else if (item.kind == HackItem::SYMBOL) {
+            out.Address(item.symbol);
+
+        } else if (item.kind == HackItem::COMPUTE) {
+            out.Compute(static_cast<uint16_t>(item.value));
+
+        } else {
+            out.Label(item.symbol);
+        }
+    }
+
+    out.Finish();
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,80 @@
+#ifndef STAGES_H
+#define STAGES_H
+
+#include "VMWriter.h"
+#include "bounded_queue.h"
+#include "code_writer.h"
+#include "instruction_sink.h"
+#include "vm_binary.h"
+
+#include <string>
+
+// VM command passed from the Jack compiler to the VM translator
+struct VMItem {
+    enum Kind { FILE, COMMAND, END };
+
+    Kind kind = END;
+    vmb::Opcode opcode = vmb::RETURN;
+    vmb::Segment segment = vmb::CONSTANT;
+    int value = 0;
+    std::string name;  // file stem for FILE, function or label for COMMAND
+};
+
+// Hack instruction passed from the VM translator to the assembler
+struct HackItem {
+    enum Kind { ADDRESS, SYMBOL, COMPUTE, LABEL, END };
+
+    Kind kind = END;
+    int value = 0;       // address or encoded compute instruction
+    std::string symbol;  // for SYMBOL and LABEL
+};
+
+using VMQueue = BoundedQueue<VMItem>;
+using HackQueue = BoundedQueue<HackItem>;
+
+// front end of the first queue, fed by VMWriter
+class VMQueueSink : public VMSink {
+  public:
+    VMQueueSink(VMQueue& queue);
+
+    // remove unwanted constructors
+    VMQueueSink(const VMQueueSink& that) = delete;
+    VMQueueSink(const VMQueueSink&& that) = delete;
+    VMQueueSink& operator=(const VMQueueSink& that) = delete;
+    VMQueueSink& operator=(const VMQueueSink&& that) = delete;
+
+    void StartFile(const std::string& stem);
+    void Write(const vmb::Opcode opcode, const vmb::Segment segment,
+               const int value, const std::string& name) override;
+    void Finish();
+
+  private:
+    VMQueue& vmQueue;
+};
+
+// front end of the second queue, fed by CodeWriter
+class HackQueueSink : public InstructionSink {
+  public:
+    HackQueueSink(HackQueue& queue);
+
+    // remove unwanted constructors
+    HackQueueSink(const HackQueueSink& that) = delete;
+    HackQueueSink(const HackQueueSink&& that) = delete;
+    HackQueueSink& operator=(const HackQueueSink& that) = delete;
+    HackQueueSink& operator=(const HackQueueSink&& that) = delete;
+
+    void Address(const int value) override;
+    void Address(const std::string& symbol) override;
+    void Compute(const uint16_t code) override;
+    void Label(const std::string& symbol) override;
+    void Finish() override;
+
+  private:
+    HackQueue& hackQueue;
+};
+
+// consumer loops, each returns once the END item has been passed on
+void TranslateStage(VMQueue& in, CodeWriter& writer);
+void AssembleStage(HackQueue& in, InstructionSink& out);
+
+#endif /* STAGES_H */
@@ -0,0 +1,98 @@
+#include "optimizer.h"
+
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+const std::string inExt = ".vm";
+
+// options
+const std::string keepScratchFlag = "--keep-scratch";
+const std::string outputFlag = "--output";
+
+void PrintUsage(const std::string& progName);
+void OptimizeVMFile(Optimizer& optimizer, const fs::path& inPath,
+                    const fs::path& outDir);
+
+int main(int argc, char* argv[]) {
+    std::string inputName = "";
+    fs::path outputDir;
+    bool allowScratchRules = true;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == keepScratchFlag) {
+            allowScratchRules = false;
+        } else if (arg == outputFlag && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else if (inputName.empty()) {
+            inputName = arg;
+        } else {
+            PrintUsage(argv[0]);
+        }
+    }
+
+    if (inputName.empty()) PrintUsage(argv[0]);
+
+    fs::path inputPath(inputName);
+    Optimizer optimizer(allowScratchRules);
+
+    if (!outputDir.empty()) fs::create_directories(outputDir);
+
+    if (fs::exists(inputPath)) {
+        if (fs::is_regular_file(inputPath)) {
+            const fs::path outDir =
+                outputDir.empty() ? inputPath.parent_path() : outputDir;
+            OptimizeVMFile(optimizer, inputPath, outDir);
+
+        } else if (fs::is_directory(inputPath)) {
+            const fs::path outDir = outputDir.empty() ? inputPath : outputDir;
+
+            for (auto& p : fs::directory_iterator(inputPath)) {
+                if (p.path().extension() != inExt) continue;
+
+                OptimizeVMFile(optimizer, p.path(), outDir);
+            }
+
+        } else {
+            std::cerr << "ERROR: Unsupported file type for " << inputPath
+                      << '\n';
+            return 0;
+        }
+
+    } else {
+        std::cerr << inputPath << " does not exist\n";
+        return 0;
+    }
+
+    optimizer.PrintReport(std::cout);
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void PrintUsage(const std::string& progName) {
+    std::cerr << "Usage: " << progName << " <.vm file or directory> ["
+              << keepScratchFlag << "] [" << outputFlag << " <dir>]\n";
+    std::cerr << "  " << keepScratchFlag
+              << "  skip rules that treat temp and THAT as compiler scratch\n";
+    std::cerr << "  " << outputFlag
+              << "        write optimized files to <dir> instead of in place\n";
+    std::exit(EXIT_FAILURE);
+}
+
+/* -------------------------------------------------------------------------- */
+
+void OptimizeVMFile(Optimizer& optimizer, const fs::path& inPath,
+                    const fs::path& outDir) {
+    auto commands = Optimizer::ReadFile(inPath);
+
+    optimizer.Run(commands);
+
+    Optimizer::WriteFile(outDir / inPath.filename(), commands);
+}
+
+/* -------------------------------------------------------------------------- */
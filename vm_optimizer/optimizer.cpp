@@ -0,0 +1,247 @@
+#include "optimizer.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+const std::string commentInitializer = "//";
+
+// comments starting with one of these words are VM commands for the
+// translator (see compiler_backend/parser.cpp) and are kept as they are
+const std::set<std::string> annotations = {"preserves"};
+
+/* -------------------------------------------------------------------------- */
+
+Optimizer::Optimizer(const bool allowScratchRules) :
+        rules(),
+        firings(),
+        commandsIn(0),
+        commandsOut(0) {
+    for (const auto& rule : rewriteRules) {
+        firings[rule.name] = 0;
+
+        if (rule.scratchOnly && !allowScratchRules) continue;
+
+        CompiledRule compiled = {&rule, {}, {}, {}};
+
+        for (const auto& line : rule.pattern) {
+            compiled.pattern.push_back(SplitWords(line));
+        }
+
+        for (const auto& line : rule.replacement) {
+            compiled.replacement.push_back(SplitWords(line));
+        }
+
+        for (const auto& line : rule.blockedBy) {
+            compiled.blockedBy.push_back(SplitWords(line));
+        }
+
+        rules.push_back(compiled);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// commands are moved to the output one at a time and the rules are tried
+// against the end of the output, so a replacement can take part in further
+// matches with the commands before it. The next input command is the one
+// checked against a rule's blockedBy patterns.
+void Optimizer::Run(std::vector<VMCommand>& commands) {
+    std::vector<VMCommand> output;
+    output.reserve(commands.size());
+
+    commandsIn += static_cast<int>(commands.size());
+
+    for (size_t n = 0; n < commands.size(); ++n) {
+        output.push_back(std::move(commands[n]));
+        const VMCommand* next =
+            (n + 1 < commands.size()) ? &commands[n + 1] : nullptr;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+
+            for (const auto& rule : rules) {
+                if (rule.pattern.size() > output.size()) continue;
+
+                const size_t pos = output.size() - rule.pattern.size();
+                Bindings bindings;
+
+                if (!Match(rule, output, pos, bindings) ||
+                    Blocked(rule, next, bindings)) {
+                    continue;
+                }
+
+                output.resize(pos);
+
+                for (const auto& templ : rule.replacement) {
+                    output.push_back(Substitute(templ, bindings));
+                }
+
+                ++firings[rule.rule->name];
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    commandsOut += static_cast<int>(output.size());
+    commands = std::move(output);
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool Optimizer::Match(const CompiledRule& rule,
+                      const std::vector<VMCommand>& commands, const size_t pos,
+                      Bindings& bindings) const {
+    for (size_t i = 0; i < rule.pattern.size(); ++i) {
+        if (!MatchWords(rule.pattern[i], commands[pos + i], bindings)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// binds any unbound variables in want to the words of have
+bool Optimizer::MatchWords(const VMCommand& want, const VMCommand& have,
+                           Bindings& bindings) const {
+    if (want.size() != have.size()) return false;
+
+    for (size_t w = 0; w < want.size(); ++w) {
+        if (want[w][0] != '$') {
+            if (want[w] != have[w]) return false;
+            continue;
+        }
+
+        const auto bound = bindings.find(want[w]);
+
+        if (bound == bindings.end()) {
+            bindings[want[w]] = have[w];
+        } else if (bound->second != have[w]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool Optimizer::Blocked(const CompiledRule& rule, const VMCommand* next,
+                        const Bindings& bindings) const {
+    if (!next) return false;
+
+    for (const auto& want : rule.blockedBy) {
+        Bindings nextBindings = bindings;
+        if (MatchWords(want, *next, nextBindings)) return true;
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+Optimizer::VMCommand Optimizer::Substitute(const VMCommand& templ,
+                                           const Bindings& bindings) const {
+    VMCommand command;
+
+    for (const auto& word : templ) {
+        if (word[0] == '$') {
+            command.push_back(bindings.at(word));
+        } else {
+            command.push_back(word);
+        }
+    }
+
+    return command;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void Optimizer::PrintReport(std::ostream& out) const {
+    out << "VM commands: " << commandsIn << " -> " << commandsOut << '\n';
+
+    for (const auto& rule : rewriteRules) {
+        out << "  " << std::left << std::setw(24) << rule.name << std::right
+            << std::setw(6) << firings.at(rule.name) << '\n';
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+std::vector<Optimizer::VMCommand> Optimizer::ReadFile(
+    const std::string& fileName) {
+    std::ifstream inFile(fileName);
+
+    if (!inFile.is_open()) {
+        std::cerr << "ERROR: Could not open file \"" << fileName << "\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<VMCommand> commands;
+    std::string line;
+
+    while (std::getline(inFile, line)) {
+        const size_t commentPos = line.find(commentInitializer);
+        VMCommand command = SplitWords(line.substr(0, commentPos));
+
+        if (command.empty() && commentPos != std::string::npos) {
+            const VMCommand comment = SplitWords(
+                line.substr(commentPos + commentInitializer.size()));
+
+            // kept with "//" as its first word, so no rule matches it
+            if (!comment.empty() &&
+                annotations.find(comment[0]) != annotations.end()) {
+                command.push_back(commentInitializer);
+                command.insert(command.end(), comment.begin(), comment.end());
+            }
+        }
+
+        if (!command.empty()) commands.push_back(command);
+    }
+
+    return commands;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void Optimizer::WriteFile(const std::string& fileName,
+                          const std::vector<VMCommand>& commands) {
+    std::ofstream outFile(fileName);
+
+    if (!outFile.is_open()) {
+        std::cerr << "ERROR: Could not open file \"" << fileName << "\"\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    for (const auto& command : commands) {
+        for (size_t i = 0; i < command.size(); ++i) {
+            if (i > 0) outFile << ' ';
+            outFile << command[i];
+        }
+
+        outFile << '\n';
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+Optimizer::VMCommand Optimizer::SplitWords(const std::string& line) {
+    std::istringstream words(line);
+    VMCommand command;
+    std::string word;
+
+    while (words >> word) {
+        command.push_back(word);
+    }
+
+    return command;
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,62 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "rule_table.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Windowed rewriting of VM code using the rules in rule_table.h. Commands are
+// handled as lists of words, so comments and spacing from the input are not
+// preserved, except for annotation comments such as "// preserves this".
+class Optimizer {
+  public:
+    using VMCommand = std::vector<std::string>;
+
+    Optimizer(const bool allowScratchRules);
+
+    // remove unwanted constructors
+    Optimizer(const Optimizer& that) = delete;
+    Optimizer(const Optimizer&& that) = delete;
+    Optimizer& operator=(const Optimizer& that) = delete;
+    Optimizer& operator=(const Optimizer&& that) = delete;
+
+    void Run(std::vector<VMCommand>& commands);
+
+    void PrintReport(std::ostream& out) const;
+
+    static std::vector<VMCommand> ReadFile(const std::string& fileName);
+    static void WriteFile(const std::string& fileName,
+                          const std::vector<VMCommand>& commands);
+
+  private:
+    struct CompiledRule {
+        const RewriteRule* rule;
+        std::vector<VMCommand> pattern;
+        std::vector<VMCommand> replacement;
+        std::vector<VMCommand> blockedBy;
+    };
+
+    std::vector<CompiledRule> rules;
+    std::map<std::string, int> firings;
+    int commandsIn;
+    int commandsOut;
+
+    using Bindings = std::map<std::string, std::string>;
+
+    bool Match(const CompiledRule& rule,
+               const std::vector<VMCommand>& commands, const size_t pos,
+               Bindings& bindings) const;
+    bool MatchWords(const VMCommand& want, const VMCommand& have,
+                    Bindings& bindings) const;
+    bool Blocked(const CompiledRule& rule, const VMCommand* next,
+                 const Bindings& bindings) const;
+    VMCommand Substitute(const VMCommand& templ,
+                         const Bindings& bindings) const;
+
+    static VMCommand SplitWords(const std::string& line);
+};
+
+#endif /* OPTIMIZER_H */
@@ -0,0 +1,68 @@
+#ifndef RULE_TABLE_H
+#define RULE_TABLE_H
+
+#include <string>
+#include <vector>
+
+// Peephole rules applied by the optimizer. A rule matches a window of
+// consecutive VM commands and replaces it with zero or more commands.
+//
+// Pattern words starting with '$' are variables: they match any word, and
+// every occurrence of the same variable within a rule must match the same
+// word. Replacement commands may use the variables bound by the pattern.
+//
+// A rule does not fire while the command after the window matches one of
+// its blockedBy patterns, which may use the variables bound by the pattern.
+//
+// Rules marked scratchOnly drop a write to a temp slot or to pointer 1 (THAT)
+// whose value is read back at once. They rely on how the Jack compiler uses
+// these as scratch: such a value is read exactly once, by the push that
+// follows the pop, and the slot is written again before any later read. The
+// read right after the window is checked by blockedBy; the rest cannot be
+// checked from a peephole window, so the rules can be disabled for VM code
+// from other sources.
+struct RewriteRule {
+    std::string name;
+    std::vector<std::string> pattern;
+    std::vector<std::string> replacement;
+    bool scratchOnly;
+    std::vector<std::string> blockedBy;
+};
+
+const std::vector<RewriteRule> rewriteRules = {
+    // stack traffic
+    {"push-pop-same", {"push $s $i", "pop $s $i"}, {}, false, {}},
+    {"pop-push-temp",
+     {"pop temp $i", "push temp $i"},
+     {},
+     true,
+     {"push temp $i"}},
+    {"pop-push-that-pointer",
+     {"pop pointer 1", "push pointer 1"},
+     {},
+     true,
+     {"push pointer 1", "push that $k", "pop that $k"}},
+
+    // algebraic identities
+    {"double-not", {"not", "not"}, {}, false, {}},
+    {"double-neg", {"neg", "neg"}, {}, false, {}},
+    {"add-zero", {"push constant 0", "add"}, {}, false, {}},
+    {"sub-zero", {"push constant 0", "sub"}, {}, false, {}},
+    {"or-zero", {"push constant 0", "or"}, {}, false, {}},
+    {"multiply-one",
+     {"push constant 1", "call Math.multiply 2"},
+     {},
+     false,
+     {}},
+    {"divide-one", {"push constant 1", "call Math.divide 2"}, {}, false, {}},
+
+    // control flow
+    {"branch-never", {"push constant 0", "if-goto $l"}, {}, false, {}},
+    {"branch-always",
+     {"push constant 0", "not", "if-goto $l"},
+     {"goto $l"},
+     false,
+     {}},
+    {"goto-next", {"goto $l", "label $l"}, {"label $l"}, false, {}}};
+
+#endif /* RULE_TABLE_H */